@@ -1,6 +1,6 @@
 #include "crypto/aes_openssl.h"
+#include "crypto/ivgen.h"
 #include <openssl/evp.h>
-#include <openssl/rand.h>
 #include <openssl/sha.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,7 +20,7 @@ int aes256_cbc_encrypt_passphrase(const uint8_t* plaintext, size_t pt_len,
     uint8_t key[32];
     uint8_t iv[16];
     sha256_key_from_pass(passphrase, key);
-    if (RAND_bytes(iv, sizeof(iv)) != 1) return -2;
+    if (ivgen_bytes(iv, sizeof(iv)) != 0) return -2;
 
     EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
     if (!ctx) return -3;
@@ -1,6 +1,7 @@
 #include "crypto/cbc.h"
+#include "crypto/ivgen.h"
 #include "crypto/padding.h"
-#include <openssl/rand.h>
+#include "util/secure_mem.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -22,7 +23,7 @@ int xfs_cbc_encrypt(const xfs_ctx_t* ctx,
     uint8_t local_iv[XFS_BLOCK_SIZE];
     if (iv) memcpy(local_iv, iv, XFS_BLOCK_SIZE);
     else {
-        if (RAND_bytes(local_iv, XFS_BLOCK_SIZE) != 1) { free(padded); free(buf); return -4; }
+        if (ivgen_bytes(local_iv, XFS_BLOCK_SIZE) != 0) { free(padded); free(buf); return -4; }
     }
     memcpy(buf, local_iv, XFS_BLOCK_SIZE);
 
@@ -46,42 +47,106 @@ int xfs_cbc_encrypt(const xfs_ctx_t* ctx,
     return 0;
 }
 
+typedef struct {
+    size_t job;
+    size_t block;
+} block_ref_t;
+
+// Decrypts the gathered blocks in one bitsliced pass and applies the CBC XOR
+// with each block's predecessor (the IV for block 0) straight from the input.
+static void flush_blocks(const xfs_ctx_t* ctx, xfs_cbc_job_t* jobs,
+                         uint8_t* buf, const block_ref_t* refs, size_t fill) {
+    xfs_decrypt_blocks(ctx, buf, buf, fill);
+    for (size_t i = 0; i < fill; i++) {
+        const xfs_cbc_job_t* j = &jobs[refs[i].job];
+        size_t off = refs[i].block * XFS_BLOCK_SIZE;
+        for (size_t b = 0; b < XFS_BLOCK_SIZE; b++)
+            j->out[off + b] = buf[i * XFS_BLOCK_SIZE + b] ^ j->in[off + b];
+    }
+}
+
+int xfs_cbc_decrypt_many(const xfs_ctx_t* ctx, xfs_cbc_job_t* jobs, size_t n) {
+    if (!ctx || (!jobs && n)) return -1;
+
+    for (size_t j = 0; j < n; j++) {
+        xfs_cbc_job_t* b = &jobs[j];
+        b->pt_len = 0;
+        if (!b->in || !b->out) b->rc = -1;
+        else if (b->in_len < XFS_BLOCK_SIZE || ((b->in_len - XFS_BLOCK_SIZE) % XFS_BLOCK_SIZE) != 0) b->rc = -2;
+        else if (b->out_cap < b->in_len - XFS_BLOCK_SIZE) b->rc = -3;
+        else b->rc = 0;
+    }
+
+    // Blocks of every ciphertext share XFS_BS_LANES-wide passes.
+    uint8_t buf[XFS_BS_LANES * XFS_BLOCK_SIZE];
+    block_ref_t refs[XFS_BS_LANES];
+    size_t fill = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (jobs[j].rc != 0) continue;
+        size_t nblocks = (jobs[j].in_len - XFS_BLOCK_SIZE) / XFS_BLOCK_SIZE;
+        for (size_t k = 0; k < nblocks; k++) {
+            memcpy(buf + fill * XFS_BLOCK_SIZE, jobs[j].in + (k + 1) * XFS_BLOCK_SIZE, XFS_BLOCK_SIZE);
+            refs[fill].job = j;
+            refs[fill].block = k;
+            if (++fill == XFS_BS_LANES) { flush_blocks(ctx, jobs, buf, refs, fill); fill = 0; }
+        }
+    }
+    if (fill) flush_blocks(ctx, jobs, buf, refs, fill);
+    secure_bzero(buf, sizeof(buf));
+
+    int rc = 0;
+    for (size_t j = 0; j < n; j++) {
+        xfs_cbc_job_t* b = &jobs[j];
+        if (b->rc == 0 &&
+            pkcs7_unpad(b->out, b->in_len - XFS_BLOCK_SIZE, XFS_BLOCK_SIZE, &b->pt_len) != 0) b->rc = -4;
+        if (b->rc != 0 && rc == 0) rc = b->rc;
+    }
+    return rc;
+}
+
+int xfs_cbc_decrypt_to(const xfs_ctx_t* ctx,
+                       const uint8_t* in, size_t in_len,
+                       uint8_t* out, size_t out_cap, size_t* pt_len) {
+    if (!ctx || !in || !out || !pt_len) return -1;
+    if (in_len < XFS_BLOCK_SIZE || ((in_len - XFS_BLOCK_SIZE) % XFS_BLOCK_SIZE) != 0) return -2;
+    if (out_cap < in_len - XFS_BLOCK_SIZE) return -3;
+
+    size_t nblocks = (in_len - XFS_BLOCK_SIZE) / XFS_BLOCK_SIZE;
+    if (nblocks >= XFS_BS_LANES) { // enough blocks to fill bitsliced passes
+        xfs_cbc_job_t job;
+        job.in = in;
+        job.in_len = in_len;
+        job.out = out;
+        job.out_cap = out_cap;
+        int rc = xfs_cbc_decrypt_many(ctx, &job, 1);
+        if (rc == 0) *pt_len = job.pt_len;
+        return rc;
+    }
+
+    for (size_t k = 0; k < nblocks; k++) {
+        uint8_t* o = out + k * XFS_BLOCK_SIZE;
+        xfs_decrypt_block(ctx, in + (k + 1) * XFS_BLOCK_SIZE, o);
+        for (size_t b = 0; b < XFS_BLOCK_SIZE; b++) o[b] ^= in[k * XFS_BLOCK_SIZE + b]; // CBC XOR
+    }
+    return pkcs7_unpad(out, in_len - XFS_BLOCK_SIZE, XFS_BLOCK_SIZE, pt_len) != 0 ? -4 : 0;
+}
+
 int xfs_cbc_decrypt(const xfs_ctx_t* ctx,
                     const uint8_t* in, size_t in_len,
                     uint8_t** plaintext, size_t* pt_len) {
     if (!ctx || !in || !plaintext || !pt_len) return -1;
     if (in_len < XFS_BLOCK_SIZE || ((in_len - XFS_BLOCK_SIZE) % XFS_BLOCK_SIZE) != 0) return -2;
 
-    const uint8_t* iv = in;
-    const uint8_t* ct = in + XFS_BLOCK_SIZE;
-    size_t ct_len = in_len - XFS_BLOCK_SIZE;
-
-    uint8_t* buf = (uint8_t*)malloc(ct_len);
+    // +1: convenient null terminator for text fields
+    uint8_t* buf = (uint8_t*)malloc(in_len - XFS_BLOCK_SIZE + 1);
     if (!buf) return -3;
 
-    uint8_t prev[XFS_BLOCK_SIZE];
-    memcpy(prev, iv, XFS_BLOCK_SIZE);
-
-    for (size_t off = 0; off < ct_len; off += XFS_BLOCK_SIZE) {
-        uint8_t dec[XFS_BLOCK_SIZE];
-        xfs_decrypt_block(ctx, ct + off, dec);
-        for (int i = 0; i < (int)XFS_BLOCK_SIZE; i++) dec[i] ^= prev[i];
-        memcpy(buf + off, dec, XFS_BLOCK_SIZE);
-        memcpy(prev, ct + off, XFS_BLOCK_SIZE);
-    }
-
     size_t unpadded_len = 0;
-    int rc = pkcs7_unpad(buf, ct_len, XFS_BLOCK_SIZE, &unpadded_len);
+    int rc = xfs_cbc_decrypt_to(ctx, in, in_len, buf, in_len - XFS_BLOCK_SIZE, &unpadded_len);
     if (rc != 0) { free(buf); return -4; }
+    buf[unpadded_len] = 0;
 
-    // shrink to exact plaintext size
-    uint8_t* out = (uint8_t*)malloc(unpadded_len + 1);
-    if (!out) { free(buf); return -5; }
-    memcpy(out, buf, unpadded_len);
-    out[unpadded_len] = 0; // convenient null terminator for text fields
-    free(buf);
-
-    *plaintext = out;
+    *plaintext = buf;
     *pt_len = unpadded_len;
     return 0;
 }
@@ -8,7 +8,7 @@ extern "C" {
 #endif
 
 // CBC mode for XFS (educational). Uses PKCS#7 padding. Output layout: [IV(16)] [CIPHERTEXT(...)]
-// If iv == NULL, generates IV with OpenSSL RAND_bytes.
+// If iv == NULL, draws the IV from ivgen (crypto/ivgen.h).
 
 int xfs_cbc_encrypt(const xfs_ctx_t* ctx,
                     const uint8_t* plaintext, size_t pt_len,
@@ -19,6 +19,35 @@ int xfs_cbc_decrypt(const xfs_ctx_t* ctx,
                     const uint8_t* in, size_t in_len,
                     uint8_t** plaintext, size_t* pt_len);
 
+// Decryption has no dependency between blocks. xfs_cbc_decrypt_many runs it on
+// the bitsliced batch primitive (xfs_decrypt_blocks: no key- or data-dependent
+// table lookups), but a pass always costs XFS_BS_LANES blocks, so single inputs
+// shorter than one pass stay on the table-based per-block cipher. This is not a
+// constant-time scheme: encryption is chained and per block, and the keyring's
+// key check value is computed with the table cipher too.
+
+// Same as xfs_cbc_decrypt but writes into caller memory (e.g. an arena) instead of
+// allocating. out_cap must be at least in_len - XFS_BLOCK_SIZE; no terminator is
+// added. out must not overlap in.
+int xfs_cbc_decrypt_to(const xfs_ctx_t* ctx,
+                       const uint8_t* in, size_t in_len,
+                       uint8_t* out, size_t out_cap, size_t* pt_len);
+
+// One ciphertext of a multi-field decrypt; pt_len and rc are outputs.
+typedef struct {
+    const uint8_t* in;
+    size_t in_len;
+    uint8_t* out;      // out_cap >= in_len - XFS_BLOCK_SIZE, must not overlap any in
+    size_t out_cap;
+    size_t pt_len;
+    int rc;            // as xfs_cbc_decrypt_to
+} xfs_cbc_job_t;
+
+// Decrypts n independent ciphertexts under one key, packing the blocks of all of
+// them into shared bitsliced passes. Returns 0 if every job succeeded, else the
+// first failing job's rc (every job is still attempted).
+int xfs_cbc_decrypt_many(const xfs_ctx_t* ctx, xfs_cbc_job_t* jobs, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
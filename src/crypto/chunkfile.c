@@ -0,0 +1,359 @@
+#include "crypto/chunkfile.h"
+#include "crypto/ivgen.h"
+#include "util/secure_mem.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Header offsets (see chunkfile.h for the overall layout)
+#define H_MAGIC       0
+#define H_VERSION     8
+#define H_CIPHER      10
+#define H_KEY_ID      12
+#define H_CHUNK_SIZE  16
+#define H_ROUNDS      20
+#define H_PLAIN_SIZE  24
+#define H_CHUNK_COUNT 32
+#define H_INDEX_OFF   40
+#define H_DATA_OFF    48
+#define H_KEY_CHECK   56
+
+// Index entry offsets
+#define E_OFFSET 0
+#define E_LENGTH 8
+#define E_IV     16
+
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+static void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+static uint64_t get_u64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+// 8-byte fingerprint of the key so a wrong key fails before any chunk is touched.
+static void key_check(const xfs_ctx_t* ctx, uint8_t out[8]) {
+    static const uint8_t probe[XFS_BLOCK_SIZE] = "XFSCHNK1-keychk";
+    uint8_t enc[XFS_BLOCK_SIZE];
+    xfs_encrypt_block(ctx, probe, enc);
+    memcpy(out, enc, 8);
+}
+
+// XORs len bytes of keystream into out, starting pos bytes into the chunk.
+// Counter block j = IV with its last 8 bytes (big-endian) incremented by j.
+static void ctr_xor(const xfs_ctx_t* ctx, const uint8_t iv[XFS_BLOCK_SIZE],
+                    uint64_t pos, const uint8_t* in, uint8_t* out, size_t len) {
+    uint64_t base = 0;
+    for (int i = 8; i < 16; i++) base = (base << 8) | iv[i];
+
+    uint64_t block = pos / XFS_BLOCK_SIZE;
+    size_t skip = (size_t)(pos % XFS_BLOCK_SIZE);
+    uint8_t ks[XFS_BS_LANES * XFS_BLOCK_SIZE]; // counters, then keystream
+
+    // Keystream is produced XFS_BS_LANES counter blocks at a time by the
+    // bitsliced batch primitive.
+    while (len) {
+        size_t nblocks = (skip + len + XFS_BLOCK_SIZE - 1) / XFS_BLOCK_SIZE;
+        if (nblocks > XFS_BS_LANES) nblocks = XFS_BS_LANES;
+        for (size_t j = 0; j < nblocks; j++) {
+            uint8_t* ctr = ks + j * XFS_BLOCK_SIZE;
+            uint64_t c = base + block + j;
+            memcpy(ctr, iv, 8);
+            for (int i = 15; i >= 8; i--) { ctr[i] = (uint8_t)c; c >>= 8; }
+        }
+        xfs_encrypt_blocks(ctx, ks, ks, nblocks);
+
+        size_t n = nblocks * XFS_BLOCK_SIZE - skip;
+        if (n > len) n = len;
+        for (size_t i = 0; i < n; i++) out[i] = in[i] ^ ks[skip + i];
+        in += n; out += n; len -= n;
+        skip = 0;
+        block += nblocks;
+    }
+    secure_bzero(ks, sizeof(ks));
+}
+
+typedef struct {
+    const uint8_t* iv;
+    uint64_t pos;      // byte position inside the chunk
+    const uint8_t* in;
+    uint8_t* out;
+    size_t len;
+} chunk_job_t;
+
+typedef struct {
+    const xfs_ctx_t* ctx;
+    chunk_job_t* jobs;
+    size_t njobs;
+    atomic_size_t next;
+} job_queue_t;
+
+static void* worker(void* arg) {
+    job_queue_t* q = (job_queue_t*)arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&q->next, 1);
+        if (i >= q->njobs) break;
+        chunk_job_t* j = &q->jobs[i];
+        ctr_xor(q->ctx, j->iv, j->pos, j->in, j->out, j->len);
+    }
+    return NULL;
+}
+
+static void run_jobs(const xfs_ctx_t* ctx, chunk_job_t* jobs, size_t njobs, unsigned threads) {
+    job_queue_t q;
+    q.ctx = ctx;
+    q.jobs = jobs;
+    q.njobs = njobs;
+    atomic_init(&q.next, 0);
+
+    if (threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (unsigned)n : 1;
+    }
+    if (threads > njobs) threads = (unsigned)njobs;
+
+    pthread_t* tids = threads > 1 ? (pthread_t*)calloc(threads - 1, sizeof(pthread_t)) : NULL;
+    unsigned started = 0;
+    for (unsigned t = 0; tids && t + 1 < threads; t++) {
+        if (pthread_create(&tids[t], NULL, worker, &q) != 0) break;
+        started++;
+    }
+    worker(&q); // calling thread works too; also drains everything if spawning failed
+    for (unsigned t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    free(tids);
+}
+
+// Maps a whole file read-only. Empty files yield map == NULL with size 0.
+static int map_input(const char* path, const uint8_t** map, uint64_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    *size = (uint64_t)st.st_size;
+    *map = NULL;
+    if (*size) {
+        void* m = mmap(NULL, (size_t)*size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) { close(fd); return -1; }
+        madvise(m, (size_t)*size, MADV_WILLNEED); // chunks are read in parallel, not in order
+        *map = (const uint8_t*)m;
+    }
+    close(fd);
+    return 0;
+}
+
+// Truncating the input through O_TRUNC would pull the pages out from under its mapping.
+static int same_file(const char* a, const char* b) {
+    struct stat sa, sb;
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0) return 0;
+    return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+// Creates out_path with all of its blocks allocated up front, so a full disk
+// fails here instead of raising SIGBUS on a store into the mapping. The
+// descriptor stays open for finish_output().
+static int map_output(const char* path, uint64_t size, uint8_t** map, int* fd_out) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return -1;
+    *map = NULL;
+    if (size) {
+        if (posix_fallocate(fd, 0, (off_t)size) != 0) { close(fd); unlink(path); return -1; }
+        void* m = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) { close(fd); unlink(path); return -1; }
+        *map = (uint8_t*)m;
+    }
+    *fd_out = fd;
+    return 0;
+}
+
+// Writes the mapping back and makes the file durable before reporting success.
+static int finish_output(uint8_t* map, uint64_t size, int fd) {
+    int rc = 0;
+    if (map) {
+        if (msync(map, (size_t)size, MS_SYNC) != 0) rc = -1;
+        if (munmap(map, (size_t)size) != 0) rc = -1;
+    }
+    if (fsync(fd) != 0) rc = -1;
+    if (close(fd) != 0) rc = -1;
+    return rc;
+}
+
+static int parse_header(const uint8_t* h, uint64_t file_size, xfs_file_info_t* info,
+                        uint64_t* index_off, uint64_t* data_off) {
+    if (file_size < XFS_FILE_HEADER_SIZE) return -1;
+    if (memcmp(h + H_MAGIC, XFS_FILE_MAGIC, 8) != 0) return -1;
+
+    info->version = get_u16(h + H_VERSION);
+    info->cipher = h[H_CIPHER];
+    info->key_id = get_u32(h + H_KEY_ID);
+    info->chunk_size = get_u32(h + H_CHUNK_SIZE);
+    info->rounds = get_u32(h + H_ROUNDS);
+    info->plain_size = get_u64(h + H_PLAIN_SIZE);
+    info->chunk_count = get_u64(h + H_CHUNK_COUNT);
+    *index_off = get_u64(h + H_INDEX_OFF);
+    *data_off = get_u64(h + H_DATA_OFF);
+
+    if (info->version != XFS_FILE_VERSION || info->cipher != XFS_FILE_CIPHER_XFS_CTR) return -2;
+    if (info->chunk_size == 0 || info->chunk_size > XFS_FILE_MAX_CHUNK) return -3;
+    uint64_t expect = (info->plain_size + info->chunk_size - 1) / info->chunk_size;
+    if (info->chunk_count != expect) return -3;
+    if (*index_off < XFS_FILE_HEADER_SIZE || *index_off > file_size ||
+        info->chunk_count > (file_size - *index_off) / XFS_FILE_INDEX_ENTRY) return -3;
+    if (*data_off > file_size || info->plain_size > file_size - *data_off) return -3;
+    return 0;
+}
+
+int xfs_file_info(const char* path, xfs_file_info_t* info) {
+    if (!path || !info) return -1;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -2;
+    uint8_t h[XFS_FILE_HEADER_SIZE];
+    ssize_t n = read(fd, h, sizeof(h));
+    struct stat st;
+    int ok = fstat(fd, &st) == 0;
+    close(fd);
+    if (!ok || n != (ssize_t)sizeof(h)) return -3;
+
+    uint64_t index_off, data_off;
+    return parse_header(h, (uint64_t)st.st_size, info, &index_off, &data_off) != 0 ? -4 : 0;
+}
+
+int xfs_file_encrypt(const xfs_ctx_t* ctx, uint32_t key_id,
+                     const char* in_path, const char* out_path,
+                     uint32_t chunk_size, unsigned threads) {
+    if (!ctx || !in_path || !out_path) return -1;
+    if (chunk_size == 0) chunk_size = XFS_FILE_DEFAULT_CHUNK;
+    if (chunk_size % XFS_BLOCK_SIZE != 0 || chunk_size > XFS_FILE_MAX_CHUNK) return -1;
+    if (same_file(in_path, out_path)) return -1;
+
+    const uint8_t* in = NULL;
+    uint64_t plain_size = 0;
+    if (map_input(in_path, &in, &plain_size) != 0) return -2;
+
+    uint64_t count = (plain_size + chunk_size - 1) / chunk_size;
+    uint64_t index_off = XFS_FILE_HEADER_SIZE;
+    uint64_t data_off = index_off + count * XFS_FILE_INDEX_ENTRY;
+    uint64_t total = data_off + plain_size;
+
+    int rc = 0, created = 0, out_fd = -1;
+    uint8_t* out = NULL;
+    chunk_job_t* jobs = NULL;
+    if (map_output(out_path, total, &out, &out_fd) != 0) { rc = -3; goto cleanup; }
+    created = 1;
+
+    memset(out, 0, (size_t)data_off);
+    memcpy(out + H_MAGIC, XFS_FILE_MAGIC, 8);
+    put_u16(out + H_VERSION, XFS_FILE_VERSION);
+    out[H_CIPHER] = XFS_FILE_CIPHER_XFS_CTR;
+    put_u32(out + H_KEY_ID, key_id);
+    put_u32(out + H_CHUNK_SIZE, chunk_size);
+    put_u32(out + H_ROUNDS, ctx->rounds);
+    put_u64(out + H_PLAIN_SIZE, plain_size);
+    put_u64(out + H_CHUNK_COUNT, count);
+    put_u64(out + H_INDEX_OFF, index_off);
+    put_u64(out + H_DATA_OFF, data_off);
+    key_check(ctx, out + H_KEY_CHECK);
+
+    if (count) {
+        jobs = (chunk_job_t*)malloc((size_t)count * sizeof(chunk_job_t));
+        if (!jobs) { rc = -4; goto cleanup; }
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint8_t* e = out + index_off + i * XFS_FILE_INDEX_ENTRY;
+        uint64_t off = i * chunk_size;
+        uint64_t len = plain_size - off < chunk_size ? plain_size - off : chunk_size;
+        put_u64(e + E_OFFSET, data_off + off);
+        put_u32(e + E_LENGTH, (uint32_t)len);
+        if (ivgen_bytes(e + E_IV, XFS_BLOCK_SIZE) != 0) { rc = -5; goto cleanup; }
+
+        jobs[i].iv = e + E_IV;
+        jobs[i].pos = 0;
+        jobs[i].in = in + off;
+        jobs[i].out = out + data_off + off;
+        jobs[i].len = (size_t)len;
+    }
+    run_jobs(ctx, jobs, (size_t)count, threads);
+
+cleanup:
+    free(jobs);
+    if (out_fd >= 0 && finish_output(out, total, out_fd) != 0 && rc == 0) rc = -6;
+    if (in) munmap((void*)in, (size_t)plain_size);
+    if (rc != 0 && created) unlink(out_path);
+    return rc;
+}
+
+int xfs_file_decrypt(const xfs_ctx_t* ctx,
+                     const char* in_path, const char* out_path,
+                     uint64_t offset, uint64_t length, unsigned threads) {
+    if (!ctx || !in_path || !out_path) return -1;
+    if (same_file(in_path, out_path)) return -1;
+
+    const uint8_t* in = NULL;
+    uint64_t file_size = 0;
+    if (map_input(in_path, &in, &file_size) != 0) return -2;
+
+    int rc = 0, created = 0, out_fd = -1;
+    uint8_t* out = NULL;
+    chunk_job_t* jobs = NULL;
+    uint64_t out_size = 0;
+
+    xfs_file_info_t info;
+    uint64_t index_off, data_off;
+    if (!in || parse_header(in, file_size, &info, &index_off, &data_off) != 0) { rc = -3; goto cleanup; }
+    if (info.rounds != ctx->rounds) { rc = -4; goto cleanup; }
+    uint8_t chk[8];
+    key_check(ctx, chk);
+    if (memcmp(chk, in + H_KEY_CHECK, 8) != 0) { rc = -4; goto cleanup; }
+
+    if (offset > info.plain_size) { rc = -5; goto cleanup; }
+    if (length == 0 || length > info.plain_size - offset) length = info.plain_size - offset;
+    out_size = length;
+    if (map_output(out_path, out_size, &out, &out_fd) != 0) { rc = -6; goto cleanup; }
+    created = 1;
+    if (!length) goto cleanup;
+
+    uint64_t first = offset / info.chunk_size;
+    uint64_t last = (offset + length - 1) / info.chunk_size;
+    size_t njobs = (size_t)(last - first + 1);
+    jobs = (chunk_job_t*)malloc(njobs * sizeof(chunk_job_t));
+    if (!jobs) { rc = -7; goto cleanup; }
+
+    for (uint64_t c = first; c <= last; c++) {
+        const uint8_t* e = in + index_off + c * XFS_FILE_INDEX_ENTRY;
+        uint64_t chunk_start = c * info.chunk_size;
+        uint64_t coff = get_u64(e + E_OFFSET);
+        uint64_t clen = get_u32(e + E_LENGTH);
+        if (coff > file_size || clen > file_size - coff) { rc = -3; goto cleanup; }
+
+        uint64_t lo = offset > chunk_start ? offset - chunk_start : 0;
+        uint64_t hi = offset + length - chunk_start;
+        if (hi > clen) hi = clen;
+        if (lo >= hi) { rc = -3; goto cleanup; }
+
+        chunk_job_t* j = &jobs[c - first];
+        j->iv = e + E_IV;
+        j->pos = lo;
+        j->in = in + coff + lo;
+        j->out = out + (chunk_start + lo - offset);
+        j->len = (size_t)(hi - lo);
+    }
+    run_jobs(ctx, jobs, njobs, threads);
+
+cleanup:
+    free(jobs);
+    if (out_fd >= 0 && finish_output(out, out_size, out_fd) != 0 && rc == 0) rc = -8;
+    if (in) munmap((void*)in, (size_t)file_size);
+    if (rc != 0 && created) unlink(out_path);
+    return rc;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "crypto/xorfeistel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seekable chunked file format for XFS (educational, no authentication).
+// Layout (all integers little-endian):
+//   [HEADER(64)] [INDEX(chunk_count * 32)] [CHUNK 0] [CHUNK 1] ...
+// Each chunk is encrypted independently in CTR mode with its own random IV, so
+// chunks are processed in parallel and any byte range decrypts without reading
+// from the start. Ciphertext chunks have the same length as the plaintext.
+
+#define XFS_FILE_MAGIC          "XFSCHNK1"
+#define XFS_FILE_VERSION        1u
+#define XFS_FILE_CIPHER_XFS_CTR 1u
+#define XFS_FILE_HEADER_SIZE    64u
+#define XFS_FILE_INDEX_ENTRY    32u
+#define XFS_FILE_DEFAULT_CHUNK  (1u << 20) // 1 MiB
+#define XFS_FILE_MAX_CHUNK      (1u << 30)
+
+typedef struct {
+    uint32_t version;
+    uint32_t cipher;
+    uint32_t key_id;
+    uint32_t rounds;       // XFS rounds the file was written with
+    uint32_t chunk_size;   // plaintext bytes per chunk (last may be shorter)
+    uint64_t plain_size;
+    uint64_t chunk_count;
+} xfs_file_info_t;
+
+// Encrypts in_path into out_path. chunk_size must be a multiple of XFS_BLOCK_SIZE
+// (0 selects XFS_FILE_DEFAULT_CHUNK); threads == 0 uses all online CPUs.
+// in_path and out_path must be different files. The output is fully allocated
+// before writing and synced to disk before 0 is returned (-3: cannot create or
+// allocate it, -6: write-back failed).
+int xfs_file_encrypt(const xfs_ctx_t* ctx, uint32_t key_id,
+                     const char* in_path, const char* out_path,
+                     uint32_t chunk_size, unsigned threads);
+
+// Decrypts plaintext bytes [offset, offset + length) of in_path into out_path.
+// length == 0 means up to the end of the file. Output handling and the
+// durability guarantee are as for xfs_file_encrypt (-4: wrong key, -6: cannot
+// create the output, -8: write-back failed).
+int xfs_file_decrypt(const xfs_ctx_t* ctx,
+                     const char* in_path, const char* out_path,
+                     uint64_t offset, uint64_t length, unsigned threads);
+
+// Reads and validates the header only.
+int xfs_file_info(const char* path, xfs_file_info_t* info);
+
+#ifdef __cplusplus
+}
+#endif
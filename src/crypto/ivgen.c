@@ -0,0 +1,68 @@
+#include "crypto/ivgen.h"
+#include "util/secure_mem.h"
+#include <openssl/rand.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t buf[IVGEN_POOL_SIZE];
+    size_t pos;       // next unused byte; IVGEN_POOL_SIZE when empty
+    unsigned gen;     // pool generation the buffer belongs to
+    int registered;   // thread-exit wipe installed
+} iv_pool_t;
+
+static _Thread_local iv_pool_t pool;
+static atomic_uint pool_gen = 1; // bumped on fork and reseed; zero-initialized pools start stale
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+static void wipe_pool(void* p) { secure_bzero(p, sizeof(iv_pool_t)); }
+static void on_fork_child(void) { atomic_fetch_add(&pool_gen, 1); }
+
+static void init_once(void) {
+    pthread_atfork(NULL, NULL, on_fork_child);
+    pthread_key_create(&exit_key, wipe_pool);
+}
+
+int ivgen_bytes(uint8_t* out, size_t len) {
+    if (!out && len) return -1;
+    pthread_once(&once, init_once);
+
+    unsigned g = atomic_load_explicit(&pool_gen, memory_order_acquire);
+    if (pool.gen != g) { pool.pos = IVGEN_POOL_SIZE; pool.gen = g; }
+    if (!pool.registered) {
+        pthread_setspecific(exit_key, &pool);
+        pool.registered = 1;
+    }
+
+    // Bulk requests gain nothing from the pool and would only drain it.
+    if (len > IVGEN_POOL_SIZE / 4) {
+        if (len > INT_MAX) return -1;
+        return RAND_bytes(out, (int)len) == 1 ? 0 : -2;
+    }
+
+    while (len) {
+        if (pool.pos == IVGEN_POOL_SIZE) {
+            if (RAND_bytes(pool.buf, (int)IVGEN_POOL_SIZE) != 1) return -2;
+            pool.pos = 0;
+        }
+        size_t n = IVGEN_POOL_SIZE - pool.pos;
+        if (n > len) n = len;
+        memcpy(out, pool.buf + pool.pos, n);
+        pool.pos += n;
+        out += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int ivgen_reseed(void) {
+    if (RAND_poll() != 1) return -1;
+    // Other threads notice the new generation on their next call.
+    atomic_fetch_add_explicit(&pool_gen, 1, memory_order_release);
+    secure_bzero(pool.buf, sizeof(pool.buf));
+    pool.pos = IVGEN_POOL_SIZE;
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Random IV source for every encrypt path. Each thread keeps a private pool that
+// is refilled IVGEN_POOL_SIZE bytes at a time from OpenSSL's DRBG, so a 16-byte IV
+// costs a memcpy instead of a locked RAND_bytes call. Pools are discarded in a
+// forked child (the parent's pending IVs must never be reused) and wiped on
+// thread exit.
+//
+// Reseed policy: ivgen itself holds no generator state, only output of
+// RAND_bytes. Seeding stays with OpenSSL, which reseeds its DRBGs from the OS
+// at its own request/time intervals and after fork. One refill is a single
+// generate call, so at most IVGEN_POOL_SIZE / 16 IVs come from one DRBG output
+// block. ivgen_reseed() forces a reseed on demand.
+
+#define IVGEN_POOL_SIZE 4096u
+
+// Fills out with len random bytes. Returns 0 on success.
+int ivgen_bytes(uint8_t* out, size_t len);
+
+// Reseeds OpenSSL's DRBG from the OS (RAND_poll) and invalidates the pools of
+// all threads, so no IV handed out afterwards was generated before the reseed.
+// Returns 0 on success.
+int ivgen_reseed(void);
+
+#ifdef __cplusplus
+}
+#endif
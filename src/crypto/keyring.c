@@ -0,0 +1,322 @@
+#include "crypto/keyring.h"
+#include "crypto/cbc.h"
+#include "util/secure_mem.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+#define NIL UINT32_MAX
+
+typedef struct {
+    _Alignas(CACHE_LINE) xfs_ctx_t xfs; // entry starts on its own cache line
+    uint8_t kcv[4];
+    uint32_t key_id;
+    uint32_t refs;   // callers currently using xfs; pinned entries are never evicted
+    uint32_t prev;   // LRU list, head = most recently used
+    uint32_t next;
+    uint32_t hnext;  // bucket chain, or free list when unused
+} key_entry_t;
+
+struct keyring {
+    pthread_mutex_t mu;
+    key_entry_t* entries;
+    uint32_t capacity;
+    uint32_t* buckets;
+    uint32_t mask;       // bucket count - 1 (power of two)
+    uint32_t lru_head;
+    uint32_t lru_tail;
+    uint32_t free_head;
+    uint32_t rounds;
+    keyring_load_fn load;
+    void* user;
+};
+
+static uint32_t bucket_of(const keyring_t* kr, uint32_t key_id) {
+    return ((key_id * 0x9e3779b1u) >> 7) & kr->mask;
+}
+
+static void compute_kcv(const xfs_ctx_t* ctx, uint8_t kcv[4]) {
+    static const uint8_t probe[XFS_BLOCK_SIZE] = "KEYRING-KCV-v1";
+    uint8_t enc[XFS_BLOCK_SIZE];
+    xfs_encrypt_block(ctx, probe, enc);
+    memcpy(kcv, enc, 4);
+}
+
+keyring_t* keyring_create(size_t capacity, uint32_t rounds, keyring_load_fn load, void* user) {
+    if (capacity == 0 || capacity >= NIL || !load) return NULL;
+    if (rounds < 8 || rounds > 32) return NULL;
+
+    keyring_t* kr = (keyring_t*)calloc(1, sizeof(keyring_t));
+    if (!kr) return NULL;
+
+    uint32_t nb = 1;
+    while (nb < 2 * capacity) nb <<= 1;
+    kr->entries = (key_entry_t*)aligned_alloc(CACHE_LINE, capacity * sizeof(key_entry_t));
+    kr->buckets = (uint32_t*)malloc(nb * sizeof(uint32_t));
+    if (!kr->entries || !kr->buckets) { free(kr->entries); free(kr->buckets); free(kr); return NULL; }
+    memset(kr->entries, 0, capacity * sizeof(key_entry_t));
+
+    kr->capacity = (uint32_t)capacity;
+    kr->mask = nb - 1;
+    for (uint32_t b = 0; b < nb; b++) kr->buckets[b] = NIL;
+    for (uint32_t i = 0; i < kr->capacity; i++) kr->entries[i].hnext = i + 1 < kr->capacity ? i + 1 : NIL;
+    kr->free_head = 0;
+    kr->lru_head = kr->lru_tail = NIL;
+    kr->rounds = rounds;
+    kr->load = load;
+    kr->user = user;
+    pthread_mutex_init(&kr->mu, NULL);
+    return kr;
+}
+
+void keyring_free(keyring_t* kr) {
+    if (!kr) return;
+    secure_bzero(kr->entries, kr->capacity * sizeof(key_entry_t));
+    free(kr->entries);
+    free(kr->buckets);
+    pthread_mutex_destroy(&kr->mu);
+    free(kr);
+}
+
+// ---- LRU / hash helpers (caller holds mu) ----
+
+static uint32_t find(const keyring_t* kr, uint32_t key_id) {
+    for (uint32_t i = kr->buckets[bucket_of(kr, key_id)]; i != NIL; i = kr->entries[i].hnext)
+        if (kr->entries[i].key_id == key_id) return i;
+    return NIL;
+}
+
+static void lru_unlink(keyring_t* kr, uint32_t i) {
+    key_entry_t* e = &kr->entries[i];
+    if (e->prev != NIL) kr->entries[e->prev].next = e->next; else kr->lru_head = e->next;
+    if (e->next != NIL) kr->entries[e->next].prev = e->prev; else kr->lru_tail = e->prev;
+}
+
+static void lru_push_front(keyring_t* kr, uint32_t i) {
+    key_entry_t* e = &kr->entries[i];
+    e->prev = NIL;
+    e->next = kr->lru_head;
+    if (kr->lru_head != NIL) kr->entries[kr->lru_head].prev = i; else kr->lru_tail = i;
+    kr->lru_head = i;
+}
+
+static void remove_entry(keyring_t* kr, uint32_t i) {
+    key_entry_t* e = &kr->entries[i];
+    uint32_t* link = &kr->buckets[bucket_of(kr, e->key_id)];
+    while (*link != i) link = &kr->entries[*link].hnext;
+    *link = e->hnext;
+    lru_unlink(kr, i);
+
+    secure_bzero(e, sizeof(*e));
+    e->hnext = kr->free_head;
+    kr->free_head = i;
+}
+
+// Free slot, evicting the least recently used unpinned schedule if needed.
+static uint32_t take_slot(keyring_t* kr) {
+    if (kr->free_head == NIL) {
+        uint32_t victim = kr->lru_tail;
+        while (victim != NIL && kr->entries[victim].refs) victim = kr->entries[victim].prev;
+        if (victim == NIL) return NIL; // every schedule is in use
+        remove_entry(kr, victim);
+    }
+    uint32_t i = kr->free_head;
+    kr->free_head = kr->entries[i].hnext;
+    return i;
+}
+
+// Returns a pinned entry for key_id, building the schedule on a miss.
+// The (possibly slow) loader and key setup run without the lock held.
+static int acquire(keyring_t* kr, uint32_t key_id, key_entry_t** out) {
+    pthread_mutex_lock(&kr->mu);
+    uint32_t i = find(kr, key_id);
+    if (i != NIL) {
+        kr->entries[i].refs++;
+        lru_unlink(kr, i);
+        lru_push_front(kr, i);
+        pthread_mutex_unlock(&kr->mu);
+        *out = &kr->entries[i];
+        return 0;
+    }
+    pthread_mutex_unlock(&kr->mu);
+
+    uint8_t key[XFS_KEY_MAX];
+    size_t key_len = 0;
+    int loaded = kr->load(kr->user, key_id, key, &key_len) == 0;
+    xfs_ctx_t ctx;
+    int ok = loaded && xfs_init(&ctx, key, key_len, kr->rounds) == 0;
+    secure_bzero(key, sizeof(key));
+    if (!ok) return loaded ? -2 : -4;
+
+    pthread_mutex_lock(&kr->mu);
+    i = find(kr, key_id); // another thread may have built it meanwhile
+    if (i == NIL) {
+        i = take_slot(kr);
+        if (i == NIL) {
+            pthread_mutex_unlock(&kr->mu);
+            secure_bzero(&ctx, sizeof(ctx));
+            return -3;
+        }
+        key_entry_t* e = &kr->entries[i];
+        memcpy(&e->xfs, &ctx, sizeof(ctx));
+        compute_kcv(&e->xfs, e->kcv);
+        e->key_id = key_id;
+        e->refs = 0;
+        uint32_t b = bucket_of(kr, key_id);
+        e->hnext = kr->buckets[b];
+        kr->buckets[b] = i;
+    } else {
+        lru_unlink(kr, i);
+    }
+    kr->entries[i].refs++;
+    lru_push_front(kr, i);
+    pthread_mutex_unlock(&kr->mu);
+
+    secure_bzero(&ctx, sizeof(ctx));
+    *out = &kr->entries[i];
+    return 0;
+}
+
+static void release(keyring_t* kr, key_entry_t* e) {
+    pthread_mutex_lock(&kr->mu);
+    e->refs--;
+    pthread_mutex_unlock(&kr->mu);
+}
+
+int keyring_evict(keyring_t* kr, uint32_t key_id) {
+    if (!kr) return -1;
+    pthread_mutex_lock(&kr->mu);
+    uint32_t i = find(kr, key_id);
+    int rc = -2;
+    if (i != NIL && kr->entries[i].refs == 0) { remove_entry(kr, i); rc = 0; }
+    else if (i != NIL) rc = -3; // in use; evicted by LRU once released
+    pthread_mutex_unlock(&kr->mu);
+    return rc;
+}
+
+// ---- tagged ciphertexts ----
+
+int keyring_is_tagged(const uint8_t* in, size_t in_len) {
+    return in && in_len >= KEYRING_HEADER_SIZE + 2 * XFS_BLOCK_SIZE &&
+           (in_len - KEYRING_HEADER_SIZE) % XFS_BLOCK_SIZE == 0 &&
+           in[0] == KEYRING_TAG_VERSION;
+}
+
+int keyring_key_id(const uint8_t* in, size_t in_len, uint32_t* key_id) {
+    if (!key_id || !keyring_is_tagged(in, in_len)) return -1;
+    *key_id = ((uint32_t)in[1] << 24) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 8) | in[4];
+    return 0;
+}
+
+int keyring_encrypt(keyring_t* kr, uint32_t key_id,
+                    const uint8_t* plaintext, size_t pt_len,
+                    uint8_t** out, size_t* out_len) {
+    if (!kr || !out || !out_len) return -1;
+
+    key_entry_t* e = NULL;
+    int rc = acquire(kr, key_id, &e);
+    if (rc != 0) return rc;
+
+    uint8_t* ct = NULL;
+    size_t ct_len = 0;
+    if (xfs_cbc_encrypt(&e->xfs, plaintext, pt_len, NULL, &ct, &ct_len) != 0) { release(kr, e); return -6; }
+
+    uint8_t* buf = (uint8_t*)malloc(KEYRING_HEADER_SIZE + ct_len);
+    if (!buf) { free(ct); release(kr, e); return -7; }
+    buf[0] = KEYRING_TAG_VERSION;
+    buf[1] = (uint8_t)(key_id >> 24);
+    buf[2] = (uint8_t)(key_id >> 16);
+    buf[3] = (uint8_t)(key_id >> 8);
+    buf[4] = (uint8_t)key_id;
+    memcpy(buf + 5, e->kcv, 4);
+    memcpy(buf + KEYRING_HEADER_SIZE, ct, ct_len);
+    release(kr, e);
+    free(ct);
+
+    *out = buf;
+    *out_len = KEYRING_HEADER_SIZE + ct_len;
+    return 0;
+}
+
+int keyring_decrypt_to(keyring_t* kr, const uint8_t* in, size_t in_len,
+                       uint8_t* out, size_t out_cap, size_t* pt_len) {
+    if (!kr || !out || !pt_len) return -1;
+    uint32_t key_id;
+    if (keyring_key_id(in, in_len, &key_id) != 0) return -1;
+
+    key_entry_t* e = NULL;
+    int rc = acquire(kr, key_id, &e);
+    if (rc != 0) return rc;
+    if (memcmp(e->kcv, in + 5, 4) != 0) { release(kr, e); return -5; }
+
+    rc = xfs_cbc_decrypt_to(&e->xfs, in + KEYRING_HEADER_SIZE, in_len - KEYRING_HEADER_SIZE,
+                            out, out_cap, pt_len);
+    release(kr, e);
+    return rc != 0 ? -6 : 0;
+}
+
+int keyring_decrypt_many(keyring_t* kr, xfs_cbc_job_t* jobs, size_t n) {
+    if (!kr || (!jobs && n)) return -1;
+    if (n == 0) return 0;
+
+    xfs_cbc_job_t* sub = (xfs_cbc_job_t*)malloc(n * sizeof(xfs_cbc_job_t));
+    size_t* idx = (size_t*)malloc(n * sizeof(size_t));
+    uint8_t* done = (uint8_t*)calloc(n, 1);
+    if (!sub || !idx || !done) { free(sub); free(idx); free(done); return -7; }
+
+    for (size_t j = 0; j < n; j++) {
+        uint32_t key_id;
+        jobs[j].pt_len = 0;
+        jobs[j].rc = keyring_key_id(jobs[j].in, jobs[j].in_len, &key_id) == 0 ? 0 : -1;
+        if (jobs[j].rc != 0) done[j] = 1;
+    }
+
+    // One schedule lookup and one batched decrypt per distinct key id.
+    for (size_t i = 0; i < n; i++) {
+        if (done[i]) continue;
+        uint32_t key_id;
+        keyring_key_id(jobs[i].in, jobs[i].in_len, &key_id);
+
+        key_entry_t* e = NULL;
+        int arc = acquire(kr, key_id, &e);
+        size_t m = 0;
+        for (size_t j = i; j < n; j++) {
+            uint32_t other;
+            if (done[j] || keyring_key_id(jobs[j].in, jobs[j].in_len, &other) != 0 || other != key_id) continue;
+            done[j] = 1;
+            if (arc != 0) { jobs[j].rc = arc; continue; }
+            if (memcmp(e->kcv, jobs[j].in + 5, 4) != 0) { jobs[j].rc = -5; continue; }
+            sub[m] = jobs[j];
+            sub[m].in += KEYRING_HEADER_SIZE;
+            sub[m].in_len -= KEYRING_HEADER_SIZE;
+            idx[m++] = j;
+        }
+        if (arc != 0) continue;
+        xfs_cbc_decrypt_many(&e->xfs, sub, m);
+        release(kr, e);
+        for (size_t k = 0; k < m; k++) {
+            jobs[idx[k]].pt_len = sub[k].pt_len;
+            jobs[idx[k]].rc = sub[k].rc != 0 ? -6 : 0;
+        }
+    }
+
+    free(sub); free(idx); free(done);
+    for (size_t j = 0; j < n; j++) if (jobs[j].rc != 0) return jobs[j].rc;
+    return 0;
+}
+
+int keyring_decrypt(keyring_t* kr, const uint8_t* in, size_t in_len,
+                    uint8_t** plaintext, size_t* pt_len) {
+    if (!plaintext || !keyring_is_tagged(in, in_len)) return -1;
+
+    size_t cap = in_len - KEYRING_HEADER_SIZE - XFS_BLOCK_SIZE;
+    uint8_t* buf = (uint8_t*)malloc(cap + 1);
+    if (!buf) return -7;
+    int rc = keyring_decrypt_to(kr, in, in_len, buf, cap, pt_len);
+    if (rc != 0) { free(buf); return rc; }
+    buf[*pt_len] = 0; // convenient null terminator for text fields
+
+    *plaintext = buf;
+    return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "crypto/cbc.h"
+#include "crypto/xorfeistel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Multi-tenant keyring: maps key ids to XFS key schedules built on first use and
+// kept in an LRU cache of bounded size. Cached schedules are cache-line aligned
+// and wiped on eviction.
+//
+// Tagged ciphertext layout: [VERSION(1)] [KEY_ID(4, big-endian)] [KCV(4)] [IV(16)] [CT(...)]
+// KCV is a key check value, so a row written under another key is rejected
+// before any block is decrypted. The 9-byte header makes tagged ciphertexts
+// 9 mod 16 bytes long, which tells them apart from plain xfs_cbc output.
+
+#define KEYRING_TAG_VERSION 1u
+#define KEYRING_HEADER_SIZE 9u
+
+// Supplies key material for key_id (e.g. from a KMS). Returns 0 and fills
+// key/key_len (1..XFS_KEY_MAX bytes) if the id is known; the keyring wipes
+// the buffer after building the schedule.
+typedef int (*keyring_load_fn)(void* user, uint32_t key_id, uint8_t key[XFS_KEY_MAX], size_t* key_len);
+
+typedef struct keyring keyring_t;
+
+// capacity: maximum cached schedules; rounds: XFS rounds for every key.
+keyring_t* keyring_create(size_t capacity, uint32_t rounds, keyring_load_fn load, void* user);
+void keyring_free(keyring_t* kr);
+
+// Drops the cached schedule for key_id (e.g. after rotation). Returns 0 if it was cached.
+int keyring_evict(keyring_t* kr, uint32_t key_id);
+
+int keyring_is_tagged(const uint8_t* in, size_t in_len);
+int keyring_key_id(const uint8_t* in, size_t in_len, uint32_t* key_id);
+
+// XFS-CBC under key_id with the tagged header (malloc'd output).
+int keyring_encrypt(keyring_t* kr, uint32_t key_id,
+                    const uint8_t* plaintext, size_t pt_len,
+                    uint8_t** out, size_t* out_len);
+
+// Decrypts a tagged ciphertext with the schedule of its key id.
+// Returns -4 for an unknown key id and -5 for a key check mismatch.
+int keyring_decrypt(keyring_t* kr, const uint8_t* in, size_t in_len,
+                    uint8_t** plaintext, size_t* pt_len);
+
+// Same, into caller memory (see xfs_cbc_decrypt_to).
+int keyring_decrypt_to(keyring_t* kr, const uint8_t* in, size_t in_len,
+                       uint8_t* out, size_t out_cap, size_t* pt_len);
+
+// Decrypts many tagged ciphertexts (see xfs_cbc_decrypt_many); fields under the
+// same key id share bitsliced passes. Per-job rc as keyring_decrypt_to.
+int keyring_decrypt_many(keyring_t* kr, xfs_cbc_job_t* jobs, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
@@ -21,6 +21,13 @@ int xfs_init(xfs_ctx_t* ctx, const uint8_t* key, size_t key_len, uint32_t rounds
 void xfs_encrypt_block(const xfs_ctx_t* ctx, const uint8_t in[XFS_BLOCK_SIZE], uint8_t out[XFS_BLOCK_SIZE]);
 void xfs_decrypt_block(const xfs_ctx_t* ctx, const uint8_t in[XFS_BLOCK_SIZE], uint8_t out[XFS_BLOCK_SIZE]);
 
+// Batch primitive for bulk data: nblocks independent blocks (in and out may alias).
+// Bitsliced, XFS_BS_LANES blocks per pass, with no table lookups or
+// data-dependent branches; output is identical to the per-block functions.
+#define XFS_BS_LANES 64u
+void xfs_encrypt_blocks(const xfs_ctx_t* ctx, const uint8_t* in, uint8_t* out, size_t nblocks);
+void xfs_decrypt_blocks(const xfs_ctx_t* ctx, const uint8_t* in, uint8_t* out, size_t nblocks);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,169 @@
+#include "crypto/xorfeistel.h"
+#include "util/secure_mem.h"
+
+// Bitsliced XFS: 64 blocks are processed at once, one uint64_t per state bit
+// (slice i holds bit i%8 of byte i/8 of every block, block b in bit b). The
+// S-box is evaluated as a boolean circuit and the rotations and byte
+// permutation of F() are index renames, so there are no data-dependent loads
+// or branches and the result matches xfs_encrypt_block/xfs_decrypt_block.
+
+typedef uint64_t slice_t;
+
+static const uint8_t PERM[8] = { 2, 5, 1, 7, 3, 0, 6, 4 }; // out[j] = tmp[PERM[j]]
+
+// All-ones if bit `bit` of the round key is set; applied with XOR.
+static inline slice_t key_mask(const uint8_t rk[16], unsigned bit) {
+    return (slice_t)0 - (slice_t)((rk[bit >> 3] >> (bit & 7)) & 1u);
+}
+
+static inline uint64_t load64_le(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void store64_le(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; i++) { p[i] = (uint8_t)v; v >>= 8; }
+}
+
+// In-place 64x64 bit matrix transpose (bit j of a[i] <-> bit i of a[j]).
+static void transpose64(uint64_t a[64]) {
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (unsigned j = 32; j; j >>= 1, m ^= m << j) {
+        for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k] ^= t << j;
+            a[k | j] ^= t;
+        }
+    }
+}
+
+// 32-bit ripple-carry addition, bit 0 first.
+static inline void add32(const slice_t a[32], const slice_t b[32], slice_t s[32]) {
+    slice_t c = 0;
+    for (int i = 0; i < 32; i++) {
+        slice_t t = a[i] ^ b[i];
+        s[i] = t ^ c;
+        c = (a[i] & b[i]) | (c & t);
+    }
+}
+
+// AES S-box as a 113-gate circuit (Boyar-Peralta). in[k]/out[k] hold bit k.
+static void sbox(const slice_t in[8], slice_t out[8]) {
+    const slice_t U0 = in[7], U1 = in[6], U2 = in[5], U3 = in[4];
+    const slice_t U4 = in[3], U5 = in[2], U6 = in[1], U7 = in[0];
+
+    slice_t T1 = U0 ^ U3, T2 = U0 ^ U5, T3 = U0 ^ U6, T4 = U3 ^ U5;
+    slice_t T5 = U4 ^ U6, T6 = T1 ^ T5, T7 = U1 ^ U2, T8 = U7 ^ T6;
+    slice_t T9 = U7 ^ T7, T10 = T6 ^ T7, T11 = U1 ^ U5, T12 = U2 ^ U5;
+    slice_t T13 = T3 ^ T4, T14 = T6 ^ T11, T15 = T5 ^ T11, T16 = T5 ^ T12;
+    slice_t T17 = T9 ^ T16, T18 = U3 ^ U7, T19 = T7 ^ T18, T20 = T1 ^ T19;
+    slice_t T21 = U6 ^ U7, T22 = T7 ^ T21, T23 = T2 ^ T22, T24 = T2 ^ T10;
+    slice_t T25 = T20 ^ T17, T26 = T3 ^ T16, T27 = T1 ^ T12;
+
+    slice_t M1 = T13 & T6, M2 = T23 & T8, M3 = T14 ^ M1, M4 = T19 & U7;
+    slice_t M5 = M4 ^ M1, M6 = T3 & T16, M7 = T22 & T9, M8 = T26 ^ M6;
+    slice_t M9 = T20 & T17, M10 = M9 ^ M6, M11 = T1 & T15, M12 = T4 & T27;
+    slice_t M13 = M12 ^ M11, M14 = T2 & T10, M15 = M14 ^ M11, M16 = M3 ^ M2;
+    slice_t M17 = M5 ^ T24, M18 = M8 ^ M7, M19 = M10 ^ M15, M20 = M16 ^ M13;
+    slice_t M21 = M17 ^ M15, M22 = M18 ^ M13, M23 = M19 ^ T25, M24 = M22 ^ M23;
+    slice_t M25 = M22 & M20, M26 = M21 ^ M25, M27 = M20 ^ M21, M28 = M23 ^ M25;
+    slice_t M29 = M28 & M27, M30 = M26 & M24, M31 = M20 & M23, M32 = M27 & M31;
+    slice_t M33 = M27 ^ M25, M34 = M21 & M22, M35 = M24 & M34, M36 = M24 ^ M25;
+    slice_t M37 = M21 ^ M29, M38 = M32 ^ M33, M39 = M23 ^ M30, M40 = M35 ^ M36;
+    slice_t M41 = M38 ^ M40, M42 = M37 ^ M39, M43 = M37 ^ M38, M44 = M39 ^ M40;
+    slice_t M45 = M42 ^ M41;
+    slice_t M46 = M44 & T6, M47 = M40 & T8, M48 = M39 & U7, M49 = M43 & T16;
+    slice_t M50 = M38 & T9, M51 = M37 & T17, M52 = M42 & T15, M53 = M45 & T27;
+    slice_t M54 = M41 & T10, M55 = M44 & T13, M56 = M40 & T23, M57 = M39 & T19;
+    slice_t M58 = M43 & T3, M59 = M38 & T22, M60 = M37 & T20, M61 = M42 & T1;
+    slice_t M62 = M45 & T4, M63 = M41 & T2;
+
+    slice_t L0 = M61 ^ M62, L1 = M50 ^ M56, L2 = M46 ^ M48, L3 = M47 ^ M55;
+    slice_t L4 = M54 ^ M58, L5 = M49 ^ M61, L6 = M62 ^ L5, L7 = M46 ^ L3;
+    slice_t L8 = M51 ^ M59, L9 = M52 ^ M53, L10 = M53 ^ L4, L11 = M60 ^ L2;
+    slice_t L12 = M48 ^ M51, L13 = M50 ^ L0, L14 = M52 ^ M61, L15 = M55 ^ L1;
+    slice_t L16 = M56 ^ L0, L17 = M57 ^ L1, L18 = M58 ^ L8, L19 = M63 ^ L4;
+    slice_t L20 = L0 ^ L1, L21 = L1 ^ L7, L22 = L3 ^ L12, L23 = L18 ^ L2;
+    slice_t L24 = L15 ^ L9, L25 = L6 ^ L10, L26 = L7 ^ L9, L27 = L8 ^ L10;
+    slice_t L28 = L11 ^ L14, L29 = L11 ^ L17;
+
+    out[7] = L6 ^ L24;
+    out[6] = ~(L16 ^ L26);
+    out[5] = ~(L19 ^ L28);
+    out[4] = L6 ^ L21;
+    out[3] = L20 ^ L22;
+    out[2] = L25 ^ L29;
+    out[1] = ~(L13 ^ L27);
+    out[0] = ~(L6 ^ L23);
+}
+
+// dst ^= F(src, rk), see F() in xorfeistel.c.
+static void feistel_round(const slice_t src[64], slice_t dst[64], const uint8_t rk[16]) {
+    slice_t a[32], b[32], x[64], s[8];
+
+    // x0 = rotl32(r0 ^ k0, 5) + (r1 ^ k1)
+    for (unsigned i = 0; i < 32; i++) {
+        a[(i + 5) & 31] = src[i] ^ key_mask(rk, i);
+        b[i] = src[32 + i] ^ key_mask(rk, 32 + i);
+    }
+    add32(a, b, x);
+
+    // x1 = rotl32(r1 ^ k2, 9) + (r0 ^ k3)
+    for (unsigned i = 0; i < 32; i++) {
+        a[(i + 9) & 31] = src[32 + i] ^ key_mask(rk, 64 + i);
+        b[i] = src[i] ^ key_mask(rk, 96 + i);
+    }
+    add32(a, b, x + 32);
+
+    // tmp[i] = SBOX[x byte i] ^ rk[i], out[j] = tmp[PERM[j]]
+    for (unsigned j = 0; j < 8; j++) {
+        unsigned t = PERM[j];
+        sbox(x + 8 * t, s);
+        for (unsigned k = 0; k < 8; k++) dst[8 * j + k] ^= s[k] ^ key_mask(rk, 8 * t + k);
+    }
+}
+
+// One batch of up to 64 blocks. Unused lanes are computed on zero blocks.
+static void crypt_batch(const xfs_ctx_t* ctx, const uint8_t* in, uint8_t* out, size_t n, int decrypt) {
+    uint64_t lo[64], hi[64];
+    for (size_t b = 0; b < 64; b++) {
+        lo[b] = b < n ? load64_le(in + b * XFS_BLOCK_SIZE) : 0;
+        hi[b] = b < n ? load64_le(in + b * XFS_BLOCK_SIZE + 8) : 0;
+    }
+    transpose64(lo);
+    transpose64(hi);
+
+    // Encryption: L = first half, L ^= F(R), swap; output R || L.
+    // Decryption is the same network with the round keys reversed.
+    slice_t* A = lo;
+    slice_t* B = hi;
+    for (uint32_t i = 0; i < ctx->rounds; i++) {
+        uint32_t r = decrypt ? ctx->rounds - 1 - i : i;
+        feistel_round(B, A, ctx->round_keys[r]);
+        slice_t* t = A; A = B; B = t;
+    }
+
+    transpose64(A);
+    transpose64(B);
+    for (size_t b = 0; b < n; b++) {
+        store64_le(out + b * XFS_BLOCK_SIZE, B[b]);
+        store64_le(out + b * XFS_BLOCK_SIZE + 8, A[b]);
+    }
+    secure_bzero(lo, sizeof(lo));
+    secure_bzero(hi, sizeof(hi));
+}
+
+void xfs_encrypt_blocks(const xfs_ctx_t* ctx, const uint8_t* in, uint8_t* out, size_t nblocks) {
+    for (size_t off = 0; off < nblocks; off += XFS_BS_LANES) {
+        size_t n = nblocks - off < XFS_BS_LANES ? nblocks - off : XFS_BS_LANES;
+        crypt_batch(ctx, in + off * XFS_BLOCK_SIZE, out + off * XFS_BLOCK_SIZE, n, 0);
+    }
+}
+
+void xfs_decrypt_blocks(const xfs_ctx_t* ctx, const uint8_t* in, uint8_t* out, size_t nblocks) {
+    for (size_t off = 0; off < nblocks; off += XFS_BS_LANES) {
+        size_t n = nblocks - off < XFS_BS_LANES ? nblocks - off : XFS_BS_LANES;
+        crypt_batch(ctx, in + off * XFS_BLOCK_SIZE, out + off * XFS_BLOCK_SIZE, n, 1);
+    }
+}
@@ -0,0 +1,656 @@
+#include "db/pg_shards.h"
+#include "crypto/ivgen.h"
+#include <libpq-fe.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ID_EPOCH_MS   1704067200000LL // 2024-01-01T00:00:00Z
+#define ID_RAND_BITS  22
+#define INSERT_TRIES  4
+#define MOVE_ROWS     4096 // rows per rebalance INSERT: 4 bind parameters each, libpq allows 65535
+
+typedef struct {
+    uint64_t point;
+    uint32_t shard;
+} ring_point_t;
+
+struct pg_shards {
+    size_t count;
+    char* conninfo[PG_SHARDS_MAX];
+    size_t npoints;
+    ring_point_t ring[PG_SHARDS_MAX * PG_SHARDS_VNODES];
+
+    pthread_t rebalance_thread;
+    int rebalance_running;
+    size_t rebalance_batch;
+    int rebalance_rc;
+    size_t rebalance_moved;
+};
+
+// splitmix64 finalizer: spreads sequential ids evenly over the ring
+static uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t fnv1a64(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) { h ^= (uint8_t)*s++; h *= 0x100000001b3ULL; }
+    return h;
+}
+
+static int cmp_point(const void* a, const void* b) {
+    uint64_t x = ((const ring_point_t*)a)->point, y = ((const ring_point_t*)b)->point;
+    return x < y ? -1 : x > y;
+}
+
+// Ring points depend only on each shard's conninfo, so the same shard list
+// always yields the same placement regardless of order.
+static void rebuild_ring(pg_shards_t* sh) {
+    sh->npoints = 0;
+    for (size_t s = 0; s < sh->count; s++) {
+        uint64_t base = fnv1a64(sh->conninfo[s]);
+        for (uint32_t v = 0; v < PG_SHARDS_VNODES; v++) {
+            sh->ring[sh->npoints].point = mix64(base + v);
+            sh->ring[sh->npoints].shard = (uint32_t)s;
+            sh->npoints++;
+        }
+    }
+    qsort(sh->ring, sh->npoints, sizeof(ring_point_t), cmp_point);
+}
+
+size_t pg_shards_owner(const pg_shards_t* sh, int64_t id) {
+    uint64_t h = mix64((uint64_t)id);
+    size_t lo = 0, hi = sh->npoints;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sh->ring[mid].point < h) lo = mid + 1; else hi = mid;
+    }
+    return sh->ring[lo == sh->npoints ? 0 : lo].shard;
+}
+
+static int add_conninfo(pg_shards_t* sh, const char* begin, size_t len) {
+    while (len && (*begin == ' ' || *begin == '\t')) { begin++; len--; }
+    while (len && (begin[len - 1] == ' ' || begin[len - 1] == '\t' ||
+                   begin[len - 1] == '\r' || begin[len - 1] == '\n')) len--;
+    if (len == 0) return 0;
+    if (sh->count == PG_SHARDS_MAX) return -1;
+
+    char* s = (char*)malloc(len + 1);
+    if (!s) return -1;
+    memcpy(s, begin, len);
+    s[len] = 0;
+    for (size_t i = 0; i < sh->count; i++)
+        if (strcmp(sh->conninfo[i], s) == 0) { free(s); return -1; }
+    sh->conninfo[sh->count++] = s;
+    return 0;
+}
+
+pg_shards_t* pg_shards_from_list(const char* list) {
+    if (!list) return NULL;
+    pg_shards_t* sh = (pg_shards_t*)calloc(1, sizeof(pg_shards_t));
+    if (!sh) return NULL;
+
+    const char* p = list;
+    for (;;) {
+        const char* end = strchr(p, ';');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (add_conninfo(sh, p, len) != 0) { pg_shards_free(sh); return NULL; }
+        if (!end) break;
+        p = end + 1;
+    }
+    if (sh->count == 0) { pg_shards_free(sh); return NULL; }
+    rebuild_ring(sh);
+    return sh;
+}
+
+pg_shards_t* pg_shards_from_file(const char* path) {
+    if (!path) return NULL;
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    pg_shards_t* sh = (pg_shards_t*)calloc(1, sizeof(pg_shards_t));
+    if (!sh) { fclose(f); return NULL; }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        if (add_conninfo(sh, line, strlen(line)) != 0) { fclose(f); pg_shards_free(sh); return NULL; }
+    }
+    fclose(f);
+    if (sh->count == 0) { pg_shards_free(sh); return NULL; }
+    rebuild_ring(sh);
+    return sh;
+}
+
+void pg_shards_free(pg_shards_t* sh) {
+    if (!sh) return;
+    if (sh->rebalance_running) pg_shards_rebalance_join(sh, NULL);
+    for (size_t i = 0; i < sh->count; i++) free(sh->conninfo[i]);
+    free(sh);
+}
+
+size_t pg_shards_count(const pg_shards_t* sh) { return sh ? sh->count : 0; }
+
+const char* pg_shards_conninfo(const pg_shards_t* sh, size_t shard) {
+    return (sh && shard < sh->count) ? sh->conninfo[shard] : NULL;
+}
+
+int pg_shards_add(pg_shards_t* sh, const char* conninfo) {
+    if (!sh || !conninfo || sh->rebalance_running) return -1;
+    if (add_conninfo(sh, conninfo, strlen(conninfo)) != 0) return -2;
+    rebuild_ring(sh);
+    return 0;
+}
+
+// Client ids need 63 bits; a pre-migration SERIAL table keeps an int4 id.
+// -3 if the id column is not BIGINT, -4 if the table is partitioned.
+static int check_shard_table(const char* conninfo) {
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
+    PGresult* r = PQexec(conn,
+        "SELECT c.relkind, a.atttypid = 'int8'::regtype"
+        "  FROM pg_class c JOIN pg_attribute a ON a.attrelid = c.oid"
+        " WHERE c.oid = 'secure_people'::regclass AND a.attname = 'id';");
+    int rc = -2;
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) == 1) {
+        if (PQgetvalue(r, 0, 0)[0] == 'p') rc = -4;
+        else rc = strcmp(PQgetvalue(r, 0, 1), "t") == 0 ? 0 : -3;
+    }
+    PQclear(r);
+    PQfinish(conn);
+    return rc;
+}
+
+// Client ids are only unique if the shard's primary key is the id alone, which
+// rules out both partition layouts. Rejected before any DDL runs.
+static int ensure_shard(const char* conninfo, const pg_schema_opts_t* opts) {
+    if (opts && opts->partition != PG_PARTITION_NONE) return -4;
+    int rc = pg_ensure_schema(conninfo, opts);
+    if (rc != 0) return rc == -5 ? -5 : -2; // -5: layout differs from the stored one
+    return check_shard_table(conninfo);
+}
+
+int pg_shards_ensure_schema(const pg_shards_t* sh, const pg_schema_opts_t* opts) {
+    if (!sh) return -1;
+    for (size_t s = 0; s < sh->count; s++) {
+        int rc = ensure_shard(sh->conninfo[s], opts);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+static int64_t new_id(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000 - ID_EPOCH_MS;
+    uint32_t r = 0;
+    if (ivgen_bytes((uint8_t*)&r, sizeof(r)) != 0) return -1;
+    return (ms << ID_RAND_BITS) | (int64_t)(r & ((1u << ID_RAND_BITS) - 1));
+}
+
+int pg_shards_insert(const pg_shards_t* sh,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     int64_t* out_id) {
+    if (!sh || !cpf_cipher || !email_cipher || !out_id) return -1;
+
+    for (int attempt = 0; attempt < INSERT_TRIES; attempt++) {
+        int64_t id = new_id();
+        if (id <= 0) return -2;
+        int rc = pg_insert_secure_person_id(sh->conninfo[pg_shards_owner(sh, id)], id,
+                                            cpf_cipher, cpf_len, email_cipher, email_len);
+        if (rc == 0) { *out_id = id; return 0; }
+        if (rc == -6) return -6; // shard has no schema yet
+        if (rc != -5) return -3; // anything but an id collision is final
+    }
+    return -4;
+}
+
+typedef struct {
+    const char* conninfo;
+    int64_t* ids;
+    size_t n;
+    pg_people_t res;
+    int rc;
+} fetch_task_t;
+
+static void* fetch_worker(void* arg) {
+    fetch_task_t* t = (fetch_task_t*)arg;
+    t->rc = pg_get_secure_people(t->conninfo, t->ids, t->n, &t->res);
+    return NULL;
+}
+
+// One thread per shard with work; the calling thread takes the last one.
+static int run_fetches(fetch_task_t* tasks, size_t ntasks) {
+    pthread_t tids[PG_SHARDS_MAX];
+    int started[PG_SHARDS_MAX] = {0};
+    size_t last = ntasks;
+    for (size_t i = 0; i < ntasks; i++) if (tasks[i].n) last = i;
+
+    for (size_t i = 0; i < ntasks; i++) {
+        memset(&tasks[i].res, 0, sizeof(tasks[i].res));
+        tasks[i].rc = 0;
+        if (!tasks[i].n || i == last) continue;
+        if (pthread_create(&tids[i], NULL, fetch_worker, &tasks[i]) == 0) started[i] = 1;
+        else fetch_worker(&tasks[i]);
+    }
+    if (last < ntasks) fetch_worker(&tasks[last]);
+
+    int rc = 0;
+    for (size_t i = 0; i < ntasks; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+        if (tasks[i].rc != 0) rc = -1;
+    }
+    return rc;
+}
+
+static int cmp_i64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Moves the results of a fetch round into out->parts (views stay valid).
+static void collect_parts(pg_sharded_people_t* out, fetch_task_t* tasks, size_t ntasks) {
+    for (size_t i = 0; i < ntasks; i++) {
+        if (!tasks[i].res.res) continue;
+        out->parts[out->nparts++] = tasks[i].res;
+        out->count += tasks[i].res.count;
+        memset(&tasks[i].res, 0, sizeof(tasks[i].res));
+    }
+}
+
+static void free_tasks(fetch_task_t* tasks, size_t ntasks) {
+    for (size_t i = 0; i < ntasks; i++) pg_people_free(&tasks[i].res);
+}
+
+int pg_shards_get(const pg_shards_t* sh, const int64_t* ids, size_t n, pg_sharded_people_t* out) {
+    if (!sh || (!ids && n) || !out) return -1;
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return 0;
+
+    size_t count = sh->count;
+    fetch_task_t tasks[PG_SHARDS_MAX];
+    int64_t* buf = (int64_t*)malloc(3 * n * sizeof(int64_t)); // grouped ids, found ids, spare
+    size_t* owner = (size_t*)malloc(n * sizeof(size_t));
+    out->parts = (pg_people_t*)calloc(3 * count, sizeof(pg_people_t));
+    if (!buf || !owner || !out->parts) { free(buf); free(owner); free(out->parts); out->parts = NULL; return -5; }
+
+    int rc = 0;
+    int64_t* found = buf + n;
+
+    // Round 1: each id on its owner shard.
+    memset(tasks, 0, sizeof(tasks));
+    for (size_t i = 0; i < n; i++) { owner[i] = pg_shards_owner(sh, ids[i]); tasks[owner[i]].n++; }
+    size_t off = 0;
+    for (size_t s = 0; s < count; s++) {
+        tasks[s].conninfo = sh->conninfo[s];
+        tasks[s].ids = buf + off;
+        off += tasks[s].n;
+        tasks[s].n = 0;
+    }
+    for (size_t i = 0; i < n; i++) tasks[owner[i]].ids[tasks[owner[i]].n++] = ids[i];
+    if (run_fetches(tasks, count) != 0) { rc = -2; goto done; }
+    collect_parts(out, tasks, count);
+
+    // Round 2: ids missing on their owner may not have been rebalanced yet.
+    if (count > 1 && out->count < n) {
+        size_t nfound = 0;
+        for (size_t p = 0; p < out->nparts; p++)
+            for (size_t r = 0; r < out->parts[p].count && nfound < n; r++)
+                found[nfound++] = out->parts[p].rows[r].id;
+        qsort(found, nfound, sizeof(int64_t), cmp_i64);
+
+        // Reuse the front of buf for the missing ids (grouped ids are no longer needed).
+        size_t nmissing = 0;
+        for (size_t i = 0; i < n; i++)
+            if (!bsearch(&ids[i], found, nfound, sizeof(int64_t), cmp_i64)) {
+                owner[nmissing] = owner[i];
+                buf[nmissing++] = ids[i];
+            }
+
+        if (nmissing) {
+            // Every non-owner shard gets its own copy of the ids it should check.
+            int64_t* lists = (int64_t*)malloc(count * nmissing * sizeof(int64_t));
+            if (!lists) { rc = -5; goto done; }
+            for (size_t s = 0; s < count; s++) {
+                tasks[s].ids = lists + s * nmissing;
+                tasks[s].n = 0;
+                for (size_t i = 0; i < nmissing; i++)
+                    if (owner[i] != s) tasks[s].ids[tasks[s].n++] = buf[i];
+            }
+            if (run_fetches(tasks, count) != 0) rc = -3;
+            else collect_parts(out, tasks, count);
+            free_tasks(tasks, count);
+            free(lists);
+            if (rc != 0) goto done;
+        }
+
+        // Round 3: a rebalance may have committed the row on its owner after
+        // round 1 and deleted it from its old shard before round 2 got there.
+        // The copy commits before the delete, so the owner has it by now.
+        if (nmissing && out->count < n) {
+            size_t nfound2 = 0;
+            for (size_t p = 0; p < out->nparts; p++)
+                for (size_t r = 0; r < out->parts[p].count && nfound2 < n; r++)
+                    found[nfound2++] = out->parts[p].rows[r].id;
+            qsort(found, nfound2, sizeof(int64_t), cmp_i64);
+
+            for (size_t s = 0; s < count; s++) tasks[s].n = 0;
+            size_t nstill = 0;
+            for (size_t i = 0; i < nmissing; i++)
+                if (!bsearch(&buf[i], found, nfound2, sizeof(int64_t), cmp_i64)) {
+                    buf[nstill] = buf[i];
+                    owner[nstill++] = owner[i];
+                    tasks[owner[i]].n++;
+                }
+            if (nstill) {
+                // Group the ids by owner in the now unused tail of found.
+                int64_t* grouped = found + nfound2;
+                size_t off2 = 0;
+                for (size_t s = 0; s < count; s++) {
+                    tasks[s].ids = grouped + off2;
+                    off2 += tasks[s].n;
+                    tasks[s].n = 0;
+                }
+                for (size_t i = 0; i < nstill; i++) tasks[owner[i]].ids[tasks[owner[i]].n++] = buf[i];
+                if (run_fetches(tasks, count) != 0) { rc = -3; goto done; }
+                collect_parts(out, tasks, count);
+            }
+        }
+    }
+
+    if (out->count) {
+        out->rows = (pg_person_view_t*)malloc(out->count * sizeof(pg_person_view_t));
+        if (!out->rows) { rc = -5; goto done; }
+        size_t k = 0;
+        for (size_t p = 0; p < out->nparts; p++) {
+            memcpy(out->rows + k, out->parts[p].rows, out->parts[p].count * sizeof(pg_person_view_t));
+            k += out->parts[p].count;
+        }
+    }
+
+done:
+    free_tasks(tasks, count);
+    free(buf);
+    free(owner);
+    if (rc != 0) pg_sharded_people_free(out);
+    return rc;
+}
+
+void pg_sharded_people_free(pg_sharded_people_t* people) {
+    if (!people) return;
+    for (size_t p = 0; p < people->nparts; p++) pg_people_free(&people->parts[p]);
+    free(people->parts);
+    free(people->rows);
+    memset(people, 0, sizeof(*people));
+}
+
+static int64_t get_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return (int64_t)v;
+}
+
+static int exec_ok(PGconn* conn, const char* sql) {
+    PGresult* r = PQexec(conn, sql);
+    int ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+    PQclear(r);
+    return ok ? 0 : -1;
+}
+
+// Opens (and migrates) a target shard on first use, then starts its batch transaction.
+// A new shard gets the storage settings of the shard rows are coming from.
+static PGconn* target_conn(const pg_shards_t* sh, PGconn** conns, int* in_tx, size_t src, size_t t) {
+    if (!conns[t]) {
+        pg_schema_opts_t opts;
+        // -2: source unreachable. -3: no stored settings (schema older than
+        // v4), the target keeps the defaults pg_load_schema_opts filled in.
+        if (pg_load_schema_opts(sh->conninfo[src], &opts) == -2) return NULL;
+        if (ensure_shard(sh->conninfo[t], &opts) != 0) return NULL;
+        conns[t] = PQconnectdb(sh->conninfo[t]);
+        if (PQstatus(conns[t]) != CONNECTION_OK) { PQfinish(conns[t]); conns[t] = NULL; return NULL; }
+    }
+    if (!in_tx[t]) {
+        if (exec_ok(conns[t], "BEGIN;") != 0) return NULL;
+        in_tx[t] = 1;
+    }
+    return conns[t];
+}
+
+static void append_id(char* buf, size_t* len, int64_t id) {
+    *len += (size_t)sprintf(buf + *len, "%s%lld", *len > 1 ? "," : "", (long long)id);
+}
+
+// Copies rows idx[0..k) of a payload result to one owner with a single
+// multi-row INSERT. Only rows now present on the owner with identical
+// ciphertexts are queued for deletion: a row the INSERT skipped is fine if an
+// earlier, interrupted run copied this very row, otherwise the owner holds a
+// different row under the same id and the source row stays as a conflict.
+static int copy_rows(PGconn* c, PGresult* rows, const int* idx, int k,
+                     char* del, size_t* del_len, size_t* moved, size_t* conflicts) {
+    size_t np = (size_t)k * 4;
+    const char** values = (const char**)malloc(np * sizeof(char*));
+    int* lengths = (int*)malloc(np * sizeof(int));
+    int* formats = (int*)malloc(np * sizeof(int));
+    char* idbufs = (char*)malloc((size_t)k * 21);
+    char* sql = (char*)malloc((size_t)k * 40 + 160);
+    int64_t* ids = (int64_t*)malloc((size_t)k * sizeof(int64_t));
+    int64_t* ins = NULL;
+    PGresult* r = NULL;
+    int rc = -1;
+    if (!values || !lengths || !formats || !idbufs || !sql || !ids) goto cleanup;
+
+    size_t len = (size_t)sprintf(sql,
+        "INSERT INTO secure_people (id, cpf_cipher, email_cipher, created_at) VALUES ");
+    for (int j = 0; j < k; j++) {
+        int i = idx[j];
+        size_t p = (size_t)j * 4;
+        char* idbuf = idbufs + (size_t)j * 21;
+        ids[j] = get_be64((const uint8_t*)PQgetvalue(rows, i, 0));
+        snprintf(idbuf, 21, "%lld", (long long)ids[j]);
+        values[p] = idbuf;
+        lengths[p] = (int)strlen(idbuf);
+        for (int f = 1; f < 4; f++) {
+            values[p + f] = PQgetvalue(rows, i, f);
+            lengths[p + f] = PQgetlength(rows, i, f);
+        }
+        formats[p] = 0;     // text id
+        formats[p + 1] = 1; // binary ciphertexts
+        formats[p + 2] = 1;
+        formats[p + 3] = 0; // created_at as text
+        len += (size_t)sprintf(sql + len, "%s($%zu,$%zu,$%zu,$%zu)", j ? "," : "", p + 1, p + 2, p + 3, p + 4);
+    }
+    strcpy(sql + len, " ON CONFLICT (id) DO NOTHING RETURNING id;");
+
+    r = PQexecParams(c, sql, (int)np, NULL, values, lengths, formats, 0);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) goto cleanup;
+    int nins = PQntuples(r);
+    ins = (int64_t*)malloc((size_t)(nins ? nins : 1) * sizeof(int64_t));
+    if (!ins) goto cleanup;
+    for (int j = 0; j < nins; j++) ins[j] = strtoll(PQgetvalue(r, j, 0), NULL, 10);
+    qsort(ins, (size_t)nins, sizeof(int64_t), cmp_i64);
+    PQclear(r);
+    r = NULL;
+
+    for (int j = 0; j < k; j++) {
+        if (!bsearch(&ids[j], ins, (size_t)nins, sizeof(int64_t), cmp_i64)) {
+            size_t p = (size_t)j * 4;
+            r = PQexecParams(c,
+                "SELECT 1 FROM secure_people WHERE id = $1 AND cpf_cipher = $2 AND email_cipher = $3;",
+                3, NULL, values + p, lengths + p, formats + p, 0);
+            int same = PQresultStatus(r) == PGRES_TUPLES_OK ? PQntuples(r) : -1;
+            PQclear(r);
+            r = NULL;
+            if (same < 0) goto cleanup;
+            if (same == 0) { (*conflicts)++; continue; }
+        }
+        append_id(del, del_len, ids[j]);
+        (*moved)++;
+    }
+    rc = 0;
+
+cleanup:
+    PQclear(r);
+    free(ins);
+    free(ids);
+    free(sql);
+    free(idbufs);
+    free(formats);
+    free(lengths);
+    free(values);
+    return rc;
+}
+
+// Copies one batch of misplaced rows to their owners, one INSERT per owner (and
+// per MOVE_ROWS rows), and commits them there.
+static int move_rows(const pg_shards_t* sh, PGresult* rows, size_t src,
+                     PGconn** conns, int* in_tx, char* del, size_t* del_len,
+                     size_t* moved, size_t* conflicts) {
+    int n = PQntuples(rows);
+    int* idx = (int*)malloc((size_t)(n ? n : 1) * sizeof(int));
+    size_t* owner = (size_t*)malloc((size_t)(n ? n : 1) * sizeof(size_t));
+    int rc = idx && owner ? 0 : -1;
+    for (int i = 0; i < n && rc == 0; i++) {
+        if (PQgetlength(rows, i, 0) != 8) { rc = -1; break; }
+        owner[i] = pg_shards_owner(sh, get_be64((const uint8_t*)PQgetvalue(rows, i, 0)));
+    }
+
+    for (size_t t = 0; t < sh->count && rc == 0; t++) {
+        if (t == src) continue;
+        int k = 0;
+        for (int i = 0; i < n; i++) if (owner[i] == t) idx[k++] = i;
+        if (k == 0) continue;
+
+        PGconn* c = target_conn(sh, conns, in_tx, src, t);
+        if (!c) { rc = -1; break; }
+        for (int off = 0; off < k && rc == 0; off += MOVE_ROWS)
+            rc = copy_rows(c, rows, idx + off, k - off < MOVE_ROWS ? k - off : MOVE_ROWS,
+                           del, del_len, moved, conflicts);
+    }
+
+    for (size_t t = 0; t < sh->count; t++) {
+        if (!in_tx[t]) continue;
+        if (exec_ok(conns[t], rc == 0 ? "COMMIT;" : "ROLLBACK;") != 0) rc = -1;
+        in_tx[t] = 0;
+    }
+    free(owner);
+    free(idx);
+    return rc;
+}
+
+// Scans ids only; ciphertexts are fetched for the rows that actually move.
+static int rebalance_shard(const pg_shards_t* sh, size_t src, size_t batch, PGconn** conns,
+                           size_t* moved, size_t* conflicts) {
+    PGconn* conn = PQconnectdb(sh->conninfo[src]);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -1; }
+
+    int in_tx[PG_SHARDS_MAX] = {0};
+    char* mv = (char*)malloc(batch * 21 + 3);  // "{" + ids + "}"
+    char* del = (char*)malloc(batch * 21 + 3);
+    if (!mv || !del) { free(mv); free(del); PQfinish(conn); return -1; }
+
+    int rc = 0;
+    char last[32] = "0";
+    char limit[32];
+    snprintf(limit, sizeof(limit), "%zu", batch);
+    for (;;) {
+        const char* values[2] = { last, limit };
+        PGresult* r = PQexecParams(conn,
+            "SELECT id::int8 FROM secure_people WHERE id > $1 ORDER BY id LIMIT $2;",
+            2, NULL, values, NULL, NULL, 1);
+        if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); rc = -1; break; }
+
+        int nrows = PQntuples(r);
+        size_t mv_len = 1;
+        mv[0] = '{';
+        for (int i = 0; i < nrows; i++) {
+            if (PQgetlength(r, i, 0) != 8) { rc = -1; break; }
+            int64_t id = get_be64((const uint8_t*)PQgetvalue(r, i, 0));
+            if (pg_shards_owner(sh, id) != src) append_id(mv, &mv_len, id);
+            if (i == nrows - 1) snprintf(last, sizeof(last), "%lld", (long long)id);
+        }
+        PQclear(r);
+        if (rc != 0 || nrows == 0) break;
+
+        if (mv_len > 1) {
+            mv[mv_len++] = '}';
+            mv[mv_len] = 0;
+            const char* mvv[1] = { mv };
+            PGresult* rows = PQexecParams(conn,
+                "SELECT id::int8, cpf_cipher, email_cipher, created_at::text FROM secure_people"
+                " WHERE id = ANY($1::int8[]);",
+                1, NULL, mvv, NULL, NULL, 1);
+            if (PQresultStatus(rows) != PGRES_TUPLES_OK) { PQclear(rows); rc = -1; break; }
+
+            size_t del_len = 1;
+            del[0] = '{';
+            size_t before = *moved;
+            rc = move_rows(sh, rows, src, conns, in_tx, del, &del_len, moved, conflicts);
+            PQclear(rows);
+            if (rc != 0) { *moved = before; break; }
+
+            // Rows are committed on their owners; only now drop them here.
+            if (del_len > 1) {
+                del[del_len++] = '}';
+                del[del_len] = 0;
+                const char* dv[1] = { del };
+                PGresult* d = PQexecParams(conn, "DELETE FROM secure_people WHERE id = ANY($1::int8[]);",
+                                           1, NULL, dv, NULL, NULL, 0);
+                if (PQresultStatus(d) != PGRES_COMMAND_OK) rc = -1;
+                PQclear(d);
+                if (rc != 0) break;
+            }
+        }
+        if ((size_t)nrows < batch) break;
+    }
+
+    free(del);
+    free(mv);
+    PQfinish(conn);
+    return rc;
+}
+
+int pg_shards_rebalance(const pg_shards_t* sh, size_t batch, size_t* moved) {
+    if (!sh) return -1;
+    if (batch == 0) batch = 1000;
+
+    PGconn* conns[PG_SHARDS_MAX] = {0};
+    size_t total = 0, conflicts = 0;
+    int rc = 0;
+    for (size_t s = 0; s < sh->count && rc == 0; s++)
+        if (rebalance_shard(sh, s, batch, conns, &total, &conflicts) != 0) rc = -2;
+    for (size_t t = 0; t < sh->count; t++) if (conns[t]) PQfinish(conns[t]);
+    if (rc == 0 && conflicts) rc = -3;
+
+    if (moved) *moved = total;
+    return rc;
+}
+
+static void* rebalance_worker(void* arg) {
+    pg_shards_t* sh = (pg_shards_t*)arg;
+    sh->rebalance_rc = pg_shards_rebalance(sh, sh->rebalance_batch, &sh->rebalance_moved);
+    return NULL;
+}
+
+int pg_shards_rebalance_start(pg_shards_t* sh, size_t batch) {
+    if (!sh || sh->rebalance_running) return -1;
+    sh->rebalance_batch = batch;
+    sh->rebalance_rc = 0;
+    sh->rebalance_moved = 0;
+    if (pthread_create(&sh->rebalance_thread, NULL, rebalance_worker, sh) != 0) return -2;
+    sh->rebalance_running = 1;
+    return 0;
+}
+
+int pg_shards_rebalance_join(pg_shards_t* sh, size_t* moved) {
+    if (!sh || !sh->rebalance_running) return -1;
+    pthread_join(sh->rebalance_thread, NULL);
+    sh->rebalance_running = 0;
+    if (moved) *moved = sh->rebalance_moved;
+    return sh->rebalance_rc;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "db/pg_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// secure_people spread over several PostgreSQL instances. Ids are generated
+// client-side (time-ordered 63-bit: ms since 2024-01-01 << 22 | 22 random bits)
+// and placed on a consistent-hash ring, so adding a shard only moves ~1/N rows.
+// Shards must be unpartitioned (PG_PARTITION_NONE): client ids are only unique
+// per shard through a primary key on id alone, which neither partition layout has.
+
+#define PG_SHARDS_MAX    64u
+#define PG_SHARDS_VNODES 128u  // ring points per shard
+
+typedef struct pg_shards pg_shards_t;
+
+// Builds a store from a ';'-separated conninfo list (e.g. PG_CONN_SHARDS).
+pg_shards_t* pg_shards_from_list(const char* list);
+// Builds a store from a file with one conninfo per line ('#' starts a comment).
+pg_shards_t* pg_shards_from_file(const char* path);
+// Waits for a running rebalance, then frees the store.
+void pg_shards_free(pg_shards_t* shards);
+
+size_t pg_shards_count(const pg_shards_t* shards);
+const char* pg_shards_conninfo(const pg_shards_t* shards, size_t shard);
+
+// Shard that owns id under the current ring.
+size_t pg_shards_owner(const pg_shards_t* shards, int64_t id);
+
+// Adds a shard to the ring. Rows it now owns stay on their old shard (and are
+// still found by pg_shards_get) until a rebalance moves them. Not thread-safe.
+int pg_shards_add(pg_shards_t* shards, const char* conninfo);
+
+// Runs the schema migrations on every shard. Returns -3 if a shard's id column
+// is not BIGINT (a pre-migration SERIAL table): client ids need 63 bits, so
+// such a shard cannot be part of the store. -4 if opts asks for a partition
+// layout or a shard is already partitioned. -5 as for pg_ensure_schema.
+int pg_shards_ensure_schema(const pg_shards_t* shards, const pg_schema_opts_t* opts);
+
+// Generates an id and inserts on its owner shard (-6: shard has no schema yet).
+int pg_shards_insert(const pg_shards_t* shards,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     int64_t* out_id);
+
+// Rows of a sharded fetch; views point into the per-shard results in parts.
+typedef struct {
+    size_t nparts;
+    pg_people_t* parts;
+    size_t count;
+    pg_person_view_t* rows;
+} pg_sharded_people_t;
+
+// Queries every owner shard in parallel and merges the rows. Ids missing on
+// their owner (not yet rebalanced) are looked up on the other shards.
+int pg_shards_get(const pg_shards_t* shards, const int64_t* ids, size_t n, pg_sharded_people_t* out);
+void pg_sharded_people_free(pg_sharded_people_t* people);
+
+// Moves every row that is not on its owner shard, batch rows at a time: rows
+// are committed on their owner before they are deleted from their old shard,
+// and pg_shards_get re-checks owners after looking elsewhere, so concurrent
+// reads and writes keep seeing every row. A source row is only deleted once
+// the owner holds an identical copy; if the owner has a different row under
+// the same id, both are kept and -3 is returned after the pass.
+int pg_shards_rebalance(const pg_shards_t* shards, size_t batch, size_t* moved);
+
+// Same, on a background thread. join returns the rebalance result.
+int pg_shards_rebalance_start(pg_shards_t* shards, size_t batch);
+int pg_shards_rebalance_join(pg_shards_t* shards, size_t* moved);
+
+#ifdef __cplusplus
+}
+#endif
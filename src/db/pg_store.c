@@ -1,32 +1,446 @@
 #include "db/pg_store.h"
 #include <libpq-fe.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static int ensure_schema(PGconn* conn) {
-    const char* sql =
-        "CREATE TABLE IF NOT EXISTS secure_people ("
-        "  id SERIAL PRIMARY KEY,"
+// Bump when appending to the migration list in apply_migration().
+#define SCHEMA_VERSION 6
+// Arbitrary key for pg_advisory_xact_lock so concurrent deployments migrate once.
+#define SCHEMA_LOCK_KEY 0x43727970746f4442LL
+// Serializes partition creation between concurrent maintenance runs.
+#define PARTITION_LOCK_KEY 0x43727970746f4450LL
+
+void pg_schema_opts_default(pg_schema_opts_t* opts) {
+    if (!opts) return;
+    opts->partition = PG_PARTITION_NONE;
+    opts->id_partition_span = 10000000;
+    opts->partitions_ahead = 2;
+    opts->id_cache = 1;
+    opts->fillfactor = 100;
+    opts->brin_created_at = 1;
+    opts->storage_external = 1;
+}
+
+static int exec_ok(PGconn* conn, const char* sql) {
+    PGresult* r = PQexec(conn, sql);
+    ExecStatusType st = PQresultStatus(r);
+    PQclear(r);
+    return (st == PGRES_COMMAND_OK || st == PGRES_TUPLES_OK) ? 0 : -1;
+}
+
+// Returns the highest applied migration, 0 if none, -1 on error.
+static int schema_version(PGconn* conn) {
+    PGresult* r = PQexec(conn, "SELECT coalesce(max(version), 0) FROM cryptodb_schema_migrations;");
+    int v = -1;
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) == 1) {
+        v = atoi(PQgetvalue(r, 0, 0));
+    } else {
+        const char* state = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+        if (state && strcmp(state, "42P01") == 0) v = 0; // undefined_table: never migrated
+    }
+    PQclear(r);
+    return v;
+}
+
+// 'p' for partitioned, 'r' for plain heap, 0 if secure_people does not exist, -1 on error.
+static int table_kind(PGconn* conn) {
+    PGresult* r = PQexec(conn,
+        "SELECT relkind FROM pg_class WHERE oid = to_regclass('secure_people');");
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    int kind = PQntuples(r) ? PQgetvalue(r, 0, 0)[0] : 0;
+    PQclear(r);
+    return kind;
+}
+
+static int create_table(PGconn* conn, const pg_schema_opts_t* o) {
+    int kind = table_kind(conn);
+    if (kind < 0) return -1;
+    if (kind != 0) return 0; // pre-migration table: keep it, v2 tunes it in place
+
+    char sql[1024];
+    if (o->partition == PG_PARTITION_NONE) {
+        snprintf(sql, sizeof(sql),
+            "CREATE TABLE secure_people ("
+            "  id BIGINT GENERATED BY DEFAULT AS IDENTITY (CACHE %d) PRIMARY KEY,"
+            "  cpf_cipher BYTEA NOT NULL,"
+            "  email_cipher BYTEA NOT NULL,"
+            "  created_at TIMESTAMPTZ NOT NULL DEFAULT now()"
+            ") WITH (fillfactor = %d);",
+            o->id_cache, o->fillfactor);
+        return exec_ok(conn, sql);
+    }
+
+    // Identity columns on partitioned parents need PG 17, so use an owned sequence.
+    snprintf(sql, sizeof(sql),
+        "CREATE SEQUENCE IF NOT EXISTS secure_people_id_seq AS BIGINT CACHE %d;", o->id_cache);
+    if (exec_ok(conn, sql) != 0) return -1;
+
+    int by_id = o->partition == PG_PARTITION_BY_ID;
+    snprintf(sql, sizeof(sql),
+        "CREATE TABLE secure_people ("
+        "  id BIGINT NOT NULL DEFAULT nextval('secure_people_id_seq'),"
         "  cpf_cipher BYTEA NOT NULL,"
         "  email_cipher BYTEA NOT NULL,"
-        "  created_at TIMESTAMPTZ DEFAULT now()"
-        ");";
-    PGresult* r = PQexec(conn, sql);
-    if (PQresultStatus(r) != PGRES_COMMAND_OK) { PQclear(r); return -1; }
+        "  created_at TIMESTAMPTZ NOT NULL DEFAULT now(),"
+        "  PRIMARY KEY (%s)"
+        ") PARTITION BY RANGE (%s);",
+        by_id ? "id" : "id, created_at", by_id ? "id" : "created_at");
+    if (exec_ok(conn, sql) != 0) return -1;
+    return exec_ok(conn, "ALTER SEQUENCE secure_people_id_seq OWNED BY secure_people.id;");
+}
+
+static int tune_storage(PGconn* conn, const pg_schema_opts_t* o) {
+    char sql[512];
+    if (o->storage_external &&
+        exec_ok(conn,
+            "ALTER TABLE secure_people"
+            "  ALTER COLUMN cpf_cipher SET STORAGE EXTERNAL,"
+            "  ALTER COLUMN email_cipher SET STORAGE EXTERNAL;") != 0) return -1;
+
+    int kind = table_kind(conn);
+    if (kind < 0) return -1;
+    if (kind == 'r') { // partitions get their fillfactor when created
+        snprintf(sql, sizeof(sql), "ALTER TABLE secure_people SET (fillfactor = %d);", o->fillfactor);
+        if (exec_ok(conn, sql) != 0) return -1;
+    }
+
+    // Heap tables may already hold data: their index is built CONCURRENTLY
+    // after the migration commits (see build_brin_index). A partitioned parent
+    // is created empty by v1, so indexing it here is free.
+    if (kind == 'p' && o->brin_created_at &&
+        exec_ok(conn,
+            "CREATE INDEX IF NOT EXISTS secure_people_created_at_brin"
+            "  ON secure_people USING brin (created_at);") != 0) return -1;
+    return 0;
+}
+
+static int create_partition_functions(PGconn* conn) {
+    if (exec_ok(conn,
+        "CREATE OR REPLACE FUNCTION secure_people_ensure_id_partitions(span bigint, ahead int, ff int)"
+        " RETURNS int LANGUAGE plpgsql AS $fn$\n"
+        "DECLARE base bigint; lo bigint; part text; created int := 0;\n"
+        "BEGIN\n"
+        "  SELECT (last_value / span) * span INTO base FROM secure_people_id_seq;\n"
+        "  FOR i IN 0..ahead LOOP\n"
+        "    lo := base + i * span;\n"
+        "    part := format('secure_people_p%s', lo / span);\n"
+        "    IF to_regclass(part) IS NULL THEN\n"
+        "      EXECUTE format('CREATE TABLE %I PARTITION OF secure_people"
+        " FOR VALUES FROM (%s) TO (%s) WITH (fillfactor = %s)', part, lo, lo + span, ff);\n"
+        "      created := created + 1;\n"
+        "    END IF;\n"
+        "  END LOOP;\n"
+        "  RETURN created;\n"
+        "END $fn$;") != 0) return -1;
+
+    return exec_ok(conn,
+        "CREATE OR REPLACE FUNCTION secure_people_ensure_month_partitions(ahead int, ff int)"
+        " RETURNS int LANGUAGE plpgsql AS $fn$\n"
+        "DECLARE lo timestamptz; part text; created int := 0;\n"
+        "BEGIN\n"
+        "  FOR i IN 0..ahead LOOP\n"
+        "    lo := date_trunc('month', now()) + make_interval(months => i);\n"
+        "    part := 'secure_people_' || to_char(lo, 'YYYY_MM');\n"
+        "    IF to_regclass(part) IS NULL THEN\n"
+        "      EXECUTE format('CREATE TABLE %I PARTITION OF secure_people"
+        " FOR VALUES FROM (%L) TO (%L) WITH (fillfactor = %s)', part, lo, lo + interval '1 month', ff);\n"
+        "      created := created + 1;\n"
+        "    END IF;\n"
+        "  END LOOP;\n"
+        "  RETURN created;\n"
+        "END $fn$;");
+}
+
+// Month partitions in UTC, whatever the TimeZone of the session that runs
+// maintenance. A partition starts where the previous one ends, so months
+// created by the v3 function under another time zone never overlap or leave
+// a gap with the new ones.
+static int month_partitions_utc(PGconn* conn) {
+    return exec_ok(conn,
+        "CREATE OR REPLACE FUNCTION secure_people_ensure_month_partitions(ahead int, ff int)"
+        " RETURNS int LANGUAGE plpgsql AS $fn$\n"
+        "DECLARE m timestamp; lo timestamptz; prev_hi text; part text; created int := 0;\n"
+        "BEGIN\n"
+        "  FOR i IN 0..ahead LOOP\n"
+        "    m := date_trunc('month', now() AT TIME ZONE 'UTC') + make_interval(months => i);\n"
+        "    part := 'secure_people_' || to_char(m, 'YYYY_MM');\n"
+        "    IF to_regclass(part) IS NULL THEN\n"
+        "      lo := m AT TIME ZONE 'UTC';\n"
+        "      SELECT (regexp_match(pg_get_expr(c.relpartbound, c.oid), 'TO \\(''([^'']+)''\\)'))[1]\n"
+        "        INTO prev_hi FROM pg_class c\n"
+        "       WHERE c.oid = to_regclass('secure_people_' || to_char(m - interval '1 month', 'YYYY_MM'));\n"
+        "      IF prev_hi IS NOT NULL THEN lo := prev_hi::timestamptz; END IF;\n"
+        "      EXECUTE format('CREATE TABLE %I PARTITION OF secure_people"
+        " FOR VALUES FROM (%L) TO (%L) WITH (fillfactor = %s)',"
+        " part, lo, (m + interval '1 month') AT TIME ZONE 'UTC', ff);\n"
+        "      created := created + 1;\n"
+        "    END IF;\n"
+        "  END LOOP;\n"
+        "  RETURN created;\n"
+        "END $fn$;");
+}
+
+// v2 used to give pre-migration SERIAL tables the configured sequence CACHE.
+// With a connection per call every session burns its cached ids, so put
+// those sequences back to CACHE 1. Tables created by v1 are left alone.
+static int reset_legacy_id_cache(PGconn* conn) {
+    PGresult* r = PQexec(conn,
+        "SELECT pg_get_serial_sequence('secure_people', 'id')"
+        "  FROM pg_attribute a JOIN pg_class c ON c.oid = a.attrelid"
+        " WHERE c.oid = 'secure_people'::regclass AND c.relkind = 'r'"
+        "   AND a.attname = 'id' AND a.attidentity = '';");
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    int rc = 0;
+    if (PQntuples(r) == 1 && !PQgetisnull(r, 0, 0)) {
+        char sql[512];
+        snprintf(sql, sizeof(sql), "ALTER SEQUENCE %s CACHE 1;", PQgetvalue(r, 0, 0));
+        rc = exec_ok(conn, sql);
+    }
+    PQclear(r);
+    return rc;
+}
+
+// Records the partition layout so maintenance never depends on the options of
+// whoever runs it. The mode (and for id ranges, the span) is read back from the
+// table itself, which also covers databases partitioned before this step existed.
+static int store_partition_settings(PGconn* conn, const pg_schema_opts_t* o) {
+    if (exec_ok(conn,
+        "CREATE TABLE cryptodb_schema_settings ("
+        "  singleton BOOLEAN PRIMARY KEY DEFAULT true CHECK (singleton),"
+        "  partition TEXT NOT NULL CHECK (partition IN ('none', 'id', 'created_at')),"
+        "  id_span BIGINT NOT NULL CHECK (id_span > 0),"
+        "  partitions_ahead INT NOT NULL CHECK (partitions_ahead >= 0),"
+        "  fillfactor INT NOT NULL CHECK (fillfactor BETWEEN 10 AND 100)"
+        ");") != 0) return -1;
+
+    char sql[1536];
+    snprintf(sql, sizeof(sql),
+        "INSERT INTO cryptodb_schema_settings (partition, id_span, partitions_ahead, fillfactor)"
+        " SELECT CASE WHEN c.relkind <> 'p' THEN 'none'"
+        "             WHEN pg_get_partkeydef(c.oid) = 'RANGE (id)' THEN 'id'"
+        "             ELSE 'created_at' END,"
+        "   coalesce((SELECT min((m.b)[2]::bigint - (m.b)[1]::bigint)"
+        "               FROM pg_inherits i JOIN pg_class p ON p.oid = i.inhrelid,"
+        "                    LATERAL regexp_match(pg_get_expr(p.relpartbound, p.oid),"
+        "                      'FROM \\(''?(-?\\d+)''?\\) TO \\(''?(-?\\d+)''?\\)') AS m(b)"
+        "              WHERE i.inhparent = c.oid), %lld),"
+        "   %d, %d"
+        " FROM pg_class c WHERE c.oid = 'secure_people'::regclass;",
+        (long long)o->id_partition_span, o->partitions_ahead, o->fillfactor);
+    if (exec_ok(conn, sql) != 0) return -1;
+
+    // Zero-argument entry point for cron / pg_cron, e.g.
+    //   SELECT cron.schedule('cryptodb-partitions', '@hourly', 'SELECT secure_people_maintain()');
+    snprintf(sql, sizeof(sql),
+        "CREATE OR REPLACE FUNCTION secure_people_maintain()"
+        " RETURNS int LANGUAGE plpgsql AS $fn$\n"
+        "DECLARE s cryptodb_schema_settings;\n"
+        "BEGIN\n"
+        "  SELECT * INTO s FROM cryptodb_schema_settings;\n"
+        "  IF NOT FOUND OR s.partition = 'none' THEN RETURN 0; END IF;\n"
+        "  PERFORM pg_advisory_xact_lock(%lld);\n"
+        "  IF s.partition = 'id' THEN\n"
+        "    RETURN secure_people_ensure_id_partitions(s.id_span, s.partitions_ahead, s.fillfactor);\n"
+        "  END IF;\n"
+        "  RETURN secure_people_ensure_month_partitions(s.partitions_ahead, s.fillfactor);\n"
+        "END $fn$;",
+        (long long)PARTITION_LOCK_KEY);
+    return exec_ok(conn, sql);
+}
+
+// Migration list. Never edit an applied step; append a new one and bump SCHEMA_VERSION.
+static int apply_migration(PGconn* conn, int version, const pg_schema_opts_t* o) {
+    switch (version) {
+        case 1: return create_table(conn, o);
+        case 2: return tune_storage(conn, o);
+        case 3: return create_partition_functions(conn);
+        case 4: return store_partition_settings(conn, o);
+        case 5: return month_partitions_utc(conn);
+        case 6: return reset_legacy_id_cache(conn);
+        default: return -1;
+    }
+}
+
+// *from receives the version the database was at before this call.
+static int migrate(PGconn* conn, const pg_schema_opts_t* o, int* from) {
+    int current = schema_version(conn);
+    if (current < 0) return -1;
+    *from = current;
+    if (current >= SCHEMA_VERSION) return 0; // common path: one catalog query
+
+    char sql[128];
+    if (exec_ok(conn, "BEGIN;") != 0) return -1;
+    snprintf(sql, sizeof(sql), "SELECT pg_advisory_xact_lock(%lld);", (long long)SCHEMA_LOCK_KEY);
+    if (exec_ok(conn, sql) != 0 ||
+        exec_ok(conn,
+            "CREATE TABLE IF NOT EXISTS cryptodb_schema_migrations ("
+            "  version INT PRIMARY KEY,"
+            "  applied_at TIMESTAMPTZ NOT NULL DEFAULT now()"
+            ");") != 0) goto fail;
+
+    // Re-read under the lock: another process may have migrated meanwhile.
+    current = schema_version(conn);
+    if (current < 0) goto fail;
+    *from = current;
+    for (int v = current + 1; v <= SCHEMA_VERSION; v++) {
+        if (apply_migration(conn, v, o) != 0) goto fail;
+        snprintf(sql, sizeof(sql), "INSERT INTO cryptodb_schema_migrations (version) VALUES (%d);", v);
+        if (exec_ok(conn, sql) != 0) goto fail;
+    }
+    return exec_ok(conn, "COMMIT;");
+
+fail:
+    exec_ok(conn, "ROLLBACK;");
+    return -1;
+}
+
+// Partition layout comes from cryptodb_schema_settings, never from the caller.
+static int maintain_partitions(PGconn* conn) {
+    return exec_ok(conn, "SELECT secure_people_maintain();");
+}
+
+// Brings an existing schema up to date without choosing a layout for it. A
+// database that has neither migrations nor a legacy table is left alone (-6):
+// its layout is fixed by the first migration, so only pg_ensure_schema with
+// explicit options may create it.
+static int migrate_existing(PGconn* conn, const pg_schema_opts_t* defaults, int* from) {
+    int current = schema_version(conn);
+    if (current < 0) return -1;
+    *from = current;
+    if (current >= SCHEMA_VERSION) return 0;
+    if (current == 0) {
+        int kind = table_kind(conn);
+        if (kind < 0) return -1;
+        if (kind == 0) return -6;
+    }
+    return migrate(conn, defaults, from) != 0 ? -1 : 0;
+}
+
+// Builds the heap table's BRIN index outside any transaction, so inserts keep
+// running while it scans the table. An interrupted CONCURRENTLY build leaves an
+// invalid index behind; it is dropped and rebuilt on the next call.
+static int build_brin_index(PGconn* conn, int create) {
+    int kind = table_kind(conn);
+    if (kind < 0) return -1;
+    if (kind != 'r') return 0;
+
+    PGresult* r = PQexec(conn,
+        "SELECT indisvalid FROM pg_index"
+        " WHERE indexrelid = to_regclass('secure_people_created_at_brin');");
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -1; }
+    int exists = PQntuples(r) == 1;
+    int valid = exists && PQgetvalue(r, 0, 0)[0] == 't';
+    PQclear(r);
+
+    if (valid || (!exists && !create)) return 0;
+    if (exists &&
+        exec_ok(conn, "DROP INDEX CONCURRENTLY IF EXISTS secure_people_created_at_brin;") != 0) return -1;
+    return exec_ok(conn,
+        "CREATE INDEX CONCURRENTLY IF NOT EXISTS secure_people_created_at_brin"
+        "  ON secure_people USING brin (created_at);");
+}
+
+// Inserts never run DDL besides creating a missing partition: the schema must
+// already exist, and upgrades are left to pg_ensure_schema.
+static int require_table(PGconn* conn) {
+    int kind = table_kind(conn);
+    if (kind < 0) return -3;
+    return kind == 0 ? -6 : 0;
+}
+
+// "no partition of relation ... found for row" is reported as check_violation.
+static int is_missing_partition(const PGresult* r) {
+    const char* state = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+    return state && strcmp(state, "23514") == 0;
+}
+
+static int opts_valid(const pg_schema_opts_t* o) {
+    return o->id_partition_span > 0 && o->partitions_ahead >= 0 && o->id_cache >= 1 &&
+           o->fillfactor >= 10 && o->fillfactor <= 100;
+}
+
+static int read_settings(PGconn* conn, pg_schema_opts_t* o) {
+    PGresult* r = PQexec(conn,
+        "SELECT partition, id_span, partitions_ahead, fillfactor FROM cryptodb_schema_settings;");
+    if (PQresultStatus(r) != PGRES_TUPLES_OK || PQntuples(r) != 1) { PQclear(r); return -1; }
+    const char* mode = PQgetvalue(r, 0, 0);
+    o->partition = strcmp(mode, "id") == 0 ? PG_PARTITION_BY_ID
+                 : strcmp(mode, "created_at") == 0 ? PG_PARTITION_BY_CREATED_AT
+                 : PG_PARTITION_NONE;
+    o->id_partition_span = strtoll(PQgetvalue(r, 0, 1), NULL, 10);
+    o->partitions_ahead = atoi(PQgetvalue(r, 0, 2));
+    o->fillfactor = atoi(PQgetvalue(r, 0, 3));
     PQclear(r);
     return 0;
 }
 
+int pg_ensure_schema(const char* conninfo, const pg_schema_opts_t* opts) {
+    if (!conninfo) return -1;
+    if (opts && !opts_valid(opts)) return -1;
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
+
+    int rc = 0, from = 0;
+    pg_schema_opts_t stored, defaults;
+    pg_schema_opts_default(&defaults);
+    const pg_schema_opts_t* o = opts ? opts : &defaults;
+    if (!opts) {
+        int m = migrate_existing(conn, o, &from);
+        if (m != 0) rc = m == -6 ? -6 : -3;
+    } else if (migrate(conn, o, &from) != 0) {
+        rc = -3;
+    }
+    // v2 defers the index on heap tables to here.
+    if (rc == 0 && build_brin_index(conn, from < 2 && o->brin_created_at) != 0) rc = -3;
+    if (rc == 0 && opts && opts->partition != PG_PARTITION_NONE) {
+        // Asking for a layout the database does not have is an error, not a no-op.
+        if (read_settings(conn, &stored) != 0) rc = -3;
+        else if (stored.partition != opts->partition ||
+                 (stored.partition == PG_PARTITION_BY_ID &&
+                  stored.id_partition_span != opts->id_partition_span)) rc = -5;
+    }
+    if (rc == 0 && maintain_partitions(conn) != 0) rc = -4;
+
+    PQfinish(conn);
+    return rc;
+}
+
+int pg_load_schema_opts(const char* conninfo, pg_schema_opts_t* opts) {
+    if (!conninfo || !opts) return -1;
+    pg_schema_opts_default(opts);
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
+
+    int rc = read_settings(conn, opts) != 0 ? -3 : 0;
+    PQfinish(conn);
+    return rc;
+}
+
+int pg_maintain_partitions(const char* conninfo) {
+    if (!conninfo) return -1;
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
+
+    int rc = maintain_partitions(conn) != 0 ? -3 : 0;
+    PQfinish(conn);
+    return rc;
+}
+
 int pg_insert_secure_person(const char* conninfo,
                             const uint8_t* cpf_cipher, size_t cpf_len,
                             const uint8_t* email_cipher, size_t email_len,
-                            int* out_id) {
+                            int64_t* out_id) {
     if (!conninfo || !cpf_cipher || !email_cipher || !out_id) return -1;
 
     PGconn* conn = PQconnectdb(conninfo);
     if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
 
-    if (ensure_schema(conn) != 0) { PQfinish(conn); return -3; }
+    int trc = require_table(conn);
+    if (trc != 0) { PQfinish(conn); return trc; }
 
     const char* paramValues[2];
     int paramLengths[2];
@@ -39,23 +453,62 @@ int pg_insert_secure_person(const char* conninfo,
     paramFormats[0] = 1; // binary
     paramFormats[1] = 1; // binary
 
-    PGresult* r = PQexecParams(conn,
-        "INSERT INTO secure_people (cpf_cipher, email_cipher) VALUES ($1, $2) RETURNING id;",
-        2, NULL, paramValues, paramLengths, paramFormats, 0);
+    const char* sql = "INSERT INTO secure_people (cpf_cipher, email_cipher) VALUES ($1, $2) RETURNING id;";
+    PGresult* r = PQexecParams(conn, sql, 2, NULL, paramValues, paramLengths, paramFormats, 0);
+    if (is_missing_partition(r) && maintain_partitions(conn) == 0) { // ran past the ready partitions
+        PQclear(r);
+        r = PQexecParams(conn, sql, 2, NULL, paramValues, paramLengths, paramFormats, 0);
+    }
 
     if (PQresultStatus(r) != PGRES_TUPLES_OK) {
         PQclear(r); PQfinish(conn); return -4;
     }
 
     char* idstr = PQgetvalue(r, 0, 0);
-    *out_id = atoi(idstr);
+    *out_id = strtoll(idstr, NULL, 10);
 
     PQclear(r);
     PQfinish(conn);
     return 0;
 }
 
-int pg_get_secure_person(const char* conninfo, int id,
+int pg_insert_secure_person_id(const char* conninfo, int64_t id,
+                               const uint8_t* cpf_cipher, size_t cpf_len,
+                               const uint8_t* email_cipher, size_t email_len) {
+    if (!conninfo || !cpf_cipher || !email_cipher) return -1;
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { PQfinish(conn); return -2; }
+
+    int trc = require_table(conn);
+    if (trc != 0) { PQfinish(conn); return trc; }
+
+    char idbuf[32];
+    snprintf(idbuf, sizeof(idbuf), "%lld", (long long)id);
+
+    const char* paramValues[3] = { idbuf, (const char*)cpf_cipher, (const char*)email_cipher };
+    int paramLengths[3] = { (int)strlen(idbuf), (int)cpf_len, (int)email_len };
+    int paramFormats[3] = { 0, 1, 1 }; // text id, binary ciphertexts
+
+    const char* sql = "INSERT INTO secure_people (id, cpf_cipher, email_cipher) VALUES ($1, $2, $3);";
+    PGresult* r = PQexecParams(conn, sql, 3, NULL, paramValues, paramLengths, paramFormats, 0);
+    if (is_missing_partition(r) && maintain_partitions(conn) == 0) {
+        PQclear(r);
+        r = PQexecParams(conn, sql, 3, NULL, paramValues, paramLengths, paramFormats, 0);
+    }
+
+    int rc = 0;
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+        const char* state = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+        rc = (state && strcmp(state, "23505") == 0) ? -5 : -4; // unique_violation
+    }
+
+    PQclear(r);
+    PQfinish(conn);
+    return rc;
+}
+
+int pg_get_secure_person(const char* conninfo, int64_t id,
                          uint8_t** cpf_cipher, size_t* cpf_len,
                          uint8_t** email_cipher, size_t* email_len) {
     if (!conninfo || !cpf_cipher || !cpf_len || !email_cipher || !email_len) return -1;
@@ -67,14 +520,14 @@ int pg_get_secure_person(const char* conninfo, int id,
     int paramLengths[1];
     int paramFormats[1];
     char idbuf[32];
-    snprintf(idbuf, sizeof(idbuf), "%d", id);
+    snprintf(idbuf, sizeof(idbuf), "%lld", (long long)id);
 
     paramValues[0] = idbuf;
     paramLengths[0] = (int)strlen(idbuf);
     paramFormats[0] = 0; // text
 
     PGresult* r = PQexecParams(conn,
-        "SELECT cpf_cipher, email_cipher FROM secure_people WHERE id = $1;",
+        "SELECT cpf_cipher, email_cipher FROM secure_people WHERE id = $1::int8;",
         1, NULL, paramValues, paramLengths, paramFormats, 1); // ask binary results
 
     if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); PQfinish(conn); return -3; }
@@ -99,3 +552,86 @@ int pg_get_secure_person(const char* conninfo, int id,
     PQfinish(conn);
     return 0;
 }
+
+// Binary wire format of a one-dimensional int8[] without NULLs.
+#define INT8OID      20
+#define INT8ARRAYOID 1016
+
+static void put_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+static int64_t get_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return (int64_t)v;
+}
+
+int pg_get_secure_people(const char* conninfo, const int64_t* ids, size_t n, pg_people_t* out) {
+    if (!conninfo || (!ids && n) || !out) return -1;
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return 0;
+    if (n > (size_t)(INT32_MAX - 20) / 12) return -1;
+
+    size_t arr_len = 20 + n * 12;
+    uint8_t* arr = (uint8_t*)malloc(arr_len);
+    if (!arr) return -5;
+    put_be32(arr, 1);            // ndim
+    put_be32(arr + 4, 0);        // no NULLs
+    put_be32(arr + 8, INT8OID);  // element type
+    put_be32(arr + 12, (uint32_t)n);
+    put_be32(arr + 16, 1);       // lower bound
+    for (size_t i = 0; i < n; i++) {
+        uint8_t* e = arr + 20 + i * 12;
+        uint64_t v = (uint64_t)ids[i];
+        put_be32(e, 8);
+        put_be32(e + 4, (uint32_t)(v >> 32));
+        put_be32(e + 8, (uint32_t)v);
+    }
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK) { free(arr); PQfinish(conn); return -2; }
+
+    const Oid paramTypes[1] = { INT8ARRAYOID };
+    const char* paramValues[1] = { (const char*)arr };
+    int paramLengths[1] = { (int)arr_len };
+    int paramFormats[1] = { 1 }; // binary
+
+    // id::int8: pre-migration SERIAL tables keep an int4 id column.
+    PGresult* r = PQexecParams(conn,
+        "SELECT id::int8, cpf_cipher, email_cipher FROM secure_people WHERE id = ANY($1);",
+        1, paramTypes, paramValues, paramLengths, paramFormats, 1);
+    free(arr);
+    // The result stays valid after the connection is closed.
+    PQfinish(conn);
+
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) { PQclear(r); return -3; }
+
+    size_t rows = (size_t)PQntuples(r);
+    pg_person_view_t* views = NULL;
+    if (rows) {
+        views = (pg_person_view_t*)malloc(rows * sizeof(pg_person_view_t));
+        if (!views) { PQclear(r); return -5; }
+    }
+    for (size_t i = 0; i < rows; i++) {
+        int row = (int)i;
+        if (PQgetlength(r, row, 0) != 8) { free(views); PQclear(r); return -4; }
+        views[i].id = get_be64((const uint8_t*)PQgetvalue(r, row, 0));
+        views[i].cpf_cipher = (const uint8_t*)PQgetvalue(r, row, 1);
+        views[i].cpf_len = (size_t)PQgetlength(r, row, 1);
+        views[i].email_cipher = (const uint8_t*)PQgetvalue(r, row, 2);
+        views[i].email_len = (size_t)PQgetlength(r, row, 2);
+    }
+
+    out->res = r;
+    out->count = rows;
+    out->rows = views;
+    return 0;
+}
+
+void pg_people_free(pg_people_t* people) {
+    if (!people) return;
+    free(people->rows);
+    PQclear((PGresult*)people->res);
+    memset(people, 0, sizeof(*people));
+}
@@ -6,17 +6,88 @@
 extern "C" {
 #endif
 
-// Inserts into secure_people table. Returns inserted id (>0) on success.
+typedef enum {
+    PG_PARTITION_NONE = 0,       // single heap table
+    PG_PARTITION_BY_ID,          // RANGE (id), fixed number of ids per partition
+    PG_PARTITION_BY_CREATED_AT   // RANGE (created_at), one partition per month
+} pg_partition_mode_t;
+
+// Options consumed by the versioned schema migrations. They only take effect the
+// first time a migration runs against a database; the resulting partition layout
+// (mode, span, partitions ahead, fillfactor) is stored in cryptodb_schema_settings
+// and every later maintenance run uses the stored values.
+typedef struct {
+    pg_partition_mode_t partition;
+    int64_t id_partition_span;  // ids per partition for PG_PARTITION_BY_ID
+    int     partitions_ahead;   // partitions kept ready past the current one
+    int     id_cache;           // CACHE of the BIGINT id sequence (ids cached by a
+                                // session are lost when it disconnects)
+    int     fillfactor;         // heap fillfactor (10..100); rows are never updated
+    int     brin_created_at;    // nonzero: BRIN index on created_at
+    int     storage_external;   // nonzero: STORAGE EXTERNAL on ciphertext columns
+} pg_schema_opts_t;
+
+// Fills opts with defaults: no partitioning, 10M ids per partition, 2 ahead,
+// cache 1, fillfactor 100, BRIN and STORAGE EXTERNAL enabled.
+void pg_schema_opts_default(pg_schema_opts_t* opts);
+
+// Applies pending schema migrations (serialized with an advisory lock) and, for
+// partitioned tables, creates upcoming partitions. Returns 0 on success.
+// With opts, a fresh database is created with that layout; -5 if opts asks for
+// a partition mode or span other than the stored one. With opts == NULL an
+// existing schema is only upgraded, and a fresh database returns -6.
+// On a plain heap table the BRIN index is built CONCURRENTLY after the
+// migration commits.
+int pg_ensure_schema(const char* conninfo, const pg_schema_opts_t* opts);
+
+// Reads the stored partition settings into opts (other fields keep defaults).
+int pg_load_schema_opts(const char* conninfo, pg_schema_opts_t* opts);
+
+// Creates missing partitions from the stored settings. Inserts do this on their
+// own when they hit a missing partition; for cron / pg_cron the same work is
+// available in SQL as SELECT secure_people_maintain();
+int pg_maintain_partitions(const char* conninfo);
+
+// The insert functions never migrate: -6 if secure_people does not exist (run
+// pg_ensure_schema with the intended options first). Upgrades need the same call.
+
+// Inserts into secure_people table. Returns 0 on success and stores the new id.
 int pg_insert_secure_person(const char* conninfo,
                             const uint8_t* cpf_cipher, size_t cpf_len,
                             const uint8_t* email_cipher, size_t email_len,
-                            int* out_id);
+                            int64_t* out_id);
+
+// Inserts with a caller-chosen id (sharded stores generate ids client-side).
+// Returns 0 on success, -5 if the id already exists.
+int pg_insert_secure_person_id(const char* conninfo, int64_t id,
+                               const uint8_t* cpf_cipher, size_t cpf_len,
+                               const uint8_t* email_cipher, size_t email_len);
 
 // Fetches by id. Returns 0 on success and allocates cpf/email buffers (caller frees).
-int pg_get_secure_person(const char* conninfo, int id,
+int pg_get_secure_person(const char* conninfo, int64_t id,
                          uint8_t** cpf_cipher, size_t* cpf_len,
                          uint8_t** email_cipher, size_t* email_len);
 
+// One row of a batch fetch. Pointers reference the result that produced them.
+typedef struct {
+    int64_t id;
+    const uint8_t* cpf_cipher;
+    size_t cpf_len;
+    const uint8_t* email_cipher;
+    size_t email_len;
+} pg_person_view_t;
+
+typedef struct {
+    void* res;               // PGresult owning every ciphertext pointer in rows
+    size_t count;
+    pg_person_view_t* rows;  // single allocation, in no particular order
+} pg_people_t;
+
+// Fetches all ids in one round trip (binary int8[] parameter, binary results).
+// Missing ids are simply absent from out. Release with pg_people_free().
+int pg_get_secure_people(const char* conninfo, const int64_t* ids, size_t n, pg_people_t* out);
+void pg_people_free(pg_people_t* people);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,294 @@
+#include "db/pg_writer.h"
+#include <libpq-fe.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct write_item {
+    struct write_item* next;
+    pg_write_cb cb;
+    void* user;
+    size_t cpf_len;
+    size_t email_len;
+    uint8_t data[]; // cpf ciphertext followed by email ciphertext
+} write_item_t;
+
+struct pg_writer {
+    PGconn* conn;
+    char* seq;             // id sequence, from pg_get_serial_sequence
+    size_t max_batch;
+    unsigned max_delay_us;
+
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    pthread_t flusher;
+    write_item_t* head;
+    write_item_t* tail;
+    size_t queued;
+    struct timespec oldest; // enqueue time of head
+    int closing;
+
+    write_item_t** batch;  // flusher scratch, max_batch entries each
+    int64_t* ids;
+};
+
+static struct timespec deadline_after(struct timespec t, unsigned us) {
+    t.tv_nsec += (long)(us % 1000000u) * 1000;
+    t.tv_sec += us / 1000000u;
+    if (t.tv_nsec >= 1000000000L) { t.tv_nsec -= 1000000000L; t.tv_sec++; }
+    return t;
+}
+
+static int before(struct timespec a, struct timespec b) {
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+// Reserves n ids in one round trip; sequences are not transactional, so a
+// failed batch only leaves gaps.
+static int reserve_ids(pg_writer_t* w, size_t n, int64_t* ids) {
+    char nbuf[32];
+    snprintf(nbuf, sizeof(nbuf), "%zu", n);
+    const char* values[2] = { w->seq, nbuf };
+    PGresult* r = PQexecParams(w->conn,
+        "SELECT nextval($1::regclass) FROM generate_series(1, $2::int);",
+        2, NULL, values, NULL, NULL, 0);
+    int rc = 0;
+    if (PQresultStatus(r) != PGRES_TUPLES_OK || (size_t)PQntuples(r) != n) rc = -1;
+    for (size_t i = 0; rc == 0 && i < n; i++) ids[i] = strtoll(PQgetvalue(r, (int)i, 0), NULL, 10);
+    PQclear(r);
+    return rc;
+}
+
+// Writes the batch as one multi-row INSERT (a single implicit transaction).
+// Ids are reserved up front so each record's id is known without relying on
+// the order of RETURNING rows.
+static int write_batch(pg_writer_t* w, write_item_t** items, size_t n, int64_t* ids) {
+    if (PQstatus(w->conn) != CONNECTION_OK) {
+        PQreset(w->conn);
+        if (PQstatus(w->conn) != CONNECTION_OK) return -2;
+    }
+    if (reserve_ids(w, n, ids) != 0) return -3;
+
+    size_t nparams = 3 * n;
+    char* sql = (char*)malloc(128 + n * 32);
+    char* idtext = (char*)malloc(n * 24);
+    const char** values = (const char**)malloc(nparams * sizeof(char*));
+    int* lengths = (int*)malloc(nparams * sizeof(int));
+    int* formats = (int*)malloc(nparams * sizeof(int));
+    int rc = -4;
+    if (!sql || !idtext || !values || !lengths || !formats) goto cleanup;
+
+    size_t len = (size_t)sprintf(sql, "INSERT INTO secure_people (id, cpf_cipher, email_cipher) VALUES ");
+    for (size_t i = 0; i < n; i++) {
+        size_t p = 3 * i;
+        len += (size_t)sprintf(sql + len, "%s($%zu, $%zu, $%zu)", i ? "," : "", p + 1, p + 2, p + 3);
+
+        char* id = idtext + i * 24;
+        snprintf(id, 24, "%lld", (long long)ids[i]);
+        values[p] = id;
+        lengths[p] = 0;
+        formats[p] = 0; // text
+        values[p + 1] = (const char*)items[i]->data;
+        lengths[p + 1] = (int)items[i]->cpf_len;
+        formats[p + 1] = 1; // binary
+        values[p + 2] = (const char*)items[i]->data + items[i]->cpf_len;
+        lengths[p + 2] = (int)items[i]->email_len;
+        formats[p + 2] = 1;
+    }
+    sql[len++] = ';';
+    sql[len] = 0;
+
+    PGresult* r = PQexecParams(w->conn, sql, (int)nparams, NULL, values, lengths, formats, 0);
+    const char* state = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+    if (state && strcmp(state, "23514") == 0) { // ran past the ready partitions
+        PQclear(r);
+        r = PQexec(w->conn, "SELECT secure_people_maintain();");
+        if (PQresultStatus(r) == PGRES_TUPLES_OK) {
+            PQclear(r);
+            r = PQexecParams(w->conn, sql, (int)nparams, NULL, values, lengths, formats, 0);
+        }
+    }
+    rc = PQresultStatus(r) == PGRES_COMMAND_OK ? 0 : -5;
+    PQclear(r);
+
+cleanup:
+    free(sql); free(idtext); free(values); free(lengths); free(formats);
+    return rc;
+}
+
+static void* flusher_main(void* arg) {
+    pg_writer_t* w = (pg_writer_t*)arg;
+    write_item_t** batch = w->batch;
+    int64_t* ids = w->ids;
+
+    for (;;) {
+        pthread_mutex_lock(&w->mu);
+        while (!w->closing && w->queued == 0) pthread_cond_wait(&w->cv, &w->mu);
+        if (w->queued == 0) { pthread_mutex_unlock(&w->mu); break; } // closing and drained
+
+        // Give concurrent writers a short window to join this commit.
+        struct timespec deadline = deadline_after(w->oldest, w->max_delay_us);
+        for (;;) {
+            if (w->closing || w->queued >= w->max_batch) break;
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (!before(now, deadline)) break;
+            pthread_cond_timedwait(&w->cv, &w->mu, &deadline);
+        }
+
+        size_t n = 0;
+        while (w->head && n < w->max_batch) {
+            batch[n++] = w->head;
+            w->head = w->head->next;
+        }
+        if (!w->head) w->tail = NULL;
+        w->queued -= n;
+        clock_gettime(CLOCK_MONOTONIC, &w->oldest); // remaining items may wait one more window
+        pthread_mutex_unlock(&w->mu);
+
+        int rc = write_batch(w, batch, n, ids);
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i]->cb) batch[i]->cb(batch[i]->user, rc, rc == 0 ? ids[i] : 0);
+            free(batch[i]);
+        }
+    }
+    return NULL;
+}
+
+pg_writer_t* pg_writer_open(const char* conninfo, size_t max_batch, unsigned max_delay_us) {
+    if (!conninfo) return NULL;
+    if (max_batch == 0) max_batch = 256;
+    if (max_batch > PG_WRITER_MAX_BATCH) max_batch = PG_WRITER_MAX_BATCH;
+    if (max_delay_us == 0) max_delay_us = 2000;
+
+    pg_writer_t* w = (pg_writer_t*)calloc(1, sizeof(pg_writer_t));
+    if (!w) return NULL;
+    w->max_batch = max_batch;
+    w->max_delay_us = max_delay_us;
+    w->batch = (write_item_t**)malloc(max_batch * sizeof(write_item_t*));
+    w->ids = (int64_t*)malloc(max_batch * sizeof(int64_t));
+    if (!w->batch || !w->ids) goto fail;
+
+    w->conn = PQconnectdb(conninfo);
+    if (PQstatus(w->conn) != CONNECTION_OK) goto fail;
+
+    PGresult* r = PQexec(w->conn, "SELECT pg_get_serial_sequence('secure_people', 'id');");
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) == 1 && !PQgetisnull(r, 0, 0))
+        w->seq = strdup(PQgetvalue(r, 0, 0));
+    PQclear(r);
+    if (!w->seq) goto fail;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&w->cv, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&w->mu, NULL);
+
+    if (pthread_create(&w->flusher, NULL, flusher_main, w) != 0) {
+        pthread_cond_destroy(&w->cv);
+        pthread_mutex_destroy(&w->mu);
+        goto fail;
+    }
+    return w;
+
+fail:
+    PQfinish(w->conn);
+    free(w->seq);
+    free(w->batch);
+    free(w->ids);
+    free(w);
+    return NULL;
+}
+
+void pg_writer_close(pg_writer_t* w) {
+    if (!w) return;
+    pthread_mutex_lock(&w->mu);
+    w->closing = 1;
+    pthread_cond_signal(&w->cv);
+    pthread_mutex_unlock(&w->mu);
+    pthread_join(w->flusher, NULL);
+
+    pthread_cond_destroy(&w->cv);
+    pthread_mutex_destroy(&w->mu);
+    PQfinish(w->conn);
+    free(w->seq);
+    free(w->batch);
+    free(w->ids);
+    free(w);
+}
+
+int pg_writer_submit(pg_writer_t* w,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     pg_write_cb cb, void* user) {
+    if (!w || !cpf_cipher || !email_cipher) return -1;
+    if (cpf_len > INT32_MAX || email_len > INT32_MAX) return -1;
+
+    write_item_t* it = (write_item_t*)malloc(sizeof(write_item_t) + cpf_len + email_len);
+    if (!it) return -2;
+    it->next = NULL;
+    it->cb = cb;
+    it->user = user;
+    it->cpf_len = cpf_len;
+    it->email_len = email_len;
+    memcpy(it->data, cpf_cipher, cpf_len);
+    memcpy(it->data + cpf_len, email_cipher, email_len);
+
+    pthread_mutex_lock(&w->mu);
+    if (w->closing) { pthread_mutex_unlock(&w->mu); free(it); return -3; }
+    if (w->tail) w->tail->next = it; else w->head = it;
+    w->tail = it;
+    if (w->queued++ == 0) clock_gettime(CLOCK_MONOTONIC, &w->oldest);
+    // Wake the flusher when work appears and when a full batch is ready.
+    if (w->queued == 1 || w->queued >= w->max_batch) pthread_cond_signal(&w->cv);
+    pthread_mutex_unlock(&w->mu);
+    return 0;
+}
+
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    int done;
+    int status;
+    int64_t id;
+} write_future_t;
+
+static void complete_future(void* user, int status, int64_t id) {
+    write_future_t* f = (write_future_t*)user;
+    pthread_mutex_lock(&f->mu);
+    f->status = status;
+    f->id = id;
+    f->done = 1;
+    pthread_cond_signal(&f->cv);
+    pthread_mutex_unlock(&f->mu);
+}
+
+int pg_writer_insert(pg_writer_t* w,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     int64_t* out_id) {
+    if (!out_id) return -1;
+
+    write_future_t f;
+    pthread_mutex_init(&f.mu, NULL);
+    pthread_cond_init(&f.cv, NULL);
+    f.done = 0;
+    f.status = 0;
+    f.id = 0;
+
+    int rc = pg_writer_submit(w, cpf_cipher, cpf_len, email_cipher, email_len, complete_future, &f);
+    if (rc == 0) {
+        pthread_mutex_lock(&f.mu);
+        while (!f.done) pthread_cond_wait(&f.cv, &f.mu);
+        pthread_mutex_unlock(&f.mu);
+        rc = f.status;
+        if (rc == 0) *out_id = f.id;
+    }
+
+    pthread_cond_destroy(&f.cv);
+    pthread_mutex_destroy(&f.mu);
+    return rc;
+}
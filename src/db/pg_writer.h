@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Group-commit write-behind queue for secure_people. Any number of threads
+// enqueue encrypted records; one flusher thread writes whatever accumulated
+// (up to max_batch rows, or after max_delay_us) as a single multi-row INSERT,
+// i.e. one transaction and one WAL flush per batch. A record is only reported
+// as written after its batch committed, so durability is unchanged.
+
+#define PG_WRITER_MAX_BATCH 10000u // 3 bind parameters per row, libpq allows 65535
+
+typedef struct pg_writer pg_writer_t;
+
+// Completion callback, invoked on the flusher thread. status is 0 on success
+// (id is the new row id) or negative if the batch failed.
+typedef void (*pg_write_cb)(void* user, int status, int64_t id);
+
+// Connects and starts the flusher. The schema must already exist (see
+// pg_ensure_schema); NULL otherwise.
+// max_batch == 0 selects 256, max_delay_us == 0 selects 2000.
+pg_writer_t* pg_writer_open(const char* conninfo, size_t max_batch, unsigned max_delay_us);
+
+// Flushes everything still queued, then stops the flusher and frees the writer.
+void pg_writer_close(pg_writer_t* w);
+
+// Queues a record (ciphertexts are copied) and returns immediately.
+int pg_writer_submit(pg_writer_t* w,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     pg_write_cb cb, void* user);
+
+// Queues a record and blocks until its batch committed.
+int pg_writer_insert(pg_writer_t* w,
+                     const uint8_t* cpf_cipher, size_t cpf_len,
+                     const uint8_t* email_cipher, size_t email_len,
+                     int64_t* out_id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,6 +6,11 @@
 #include "crypto/xorfeistel.h"
 #include "crypto/cbc.h"
 #include "crypto/aes_openssl.h"
+#include "crypto/ivgen.h"
+#include "db/pg_store.h"
+#include "db/pg_writer.h"
+#include <openssl/rand.h>
+#include <pthread.h>
 #include "util/secure_mem.h"
 
 static int arg_eq(const char* a, const char* b) { return a && b && strcmp(a,b)==0; }
@@ -17,17 +22,165 @@ static double now_sec(void) {
 }
 
 static void usage(void) {
-    puts("cryptodb_bench --mb <N> --key <pass>\n"
-         "  --mb  data size in MB (default 64)\n");
+    puts("cryptodb_bench --mb <N> --records <N> --key <pass> [--inserts <N> --writers <T>]\n"
+         "  --mb       data size in MB (default 64)\n"
+         "  --records  field-sized records for the per-record IV test (default 200000)\n"
+         "  --inserts  rows for the insert test against PG_CONN (default 0: skipped)\n"
+         "  --writers  concurrent inserting threads for the insert test (default 8)\n");
+}
+
+// Per-record cost of IV generation on 32-byte fields: one RAND_bytes per record
+// (previous behaviour) versus the buffered ivgen pool used by the encrypt paths.
+static int bench_records(const xfs_ctx_t* ctx, size_t records) {
+    uint8_t field[32];
+    memset(field, 0x5a, sizeof(field));
+    uint8_t iv[XFS_BLOCK_SIZE];
+    uint8_t* ct = NULL; size_t ct_len = 0;
+
+    double t0 = now_sec();
+    for (size_t i = 0; i < records; i++) {
+        if (RAND_bytes(iv, sizeof(iv)) != 1) return -1;
+        if (xfs_cbc_encrypt(ctx, field, sizeof(field), iv, &ct, &ct_len) != 0) return -1;
+        free(ct);
+    }
+    double t1 = now_sec();
+    for (size_t i = 0; i < records; i++) {
+        if (xfs_cbc_encrypt(ctx, field, sizeof(field), NULL, &ct, &ct_len) != 0) return -1;
+        free(ct);
+    }
+    double t2 = now_sec();
+    for (size_t i = 0; i < records; i++)
+        if (RAND_bytes(iv, sizeof(iv)) != 1) return -1;
+    double t3 = now_sec();
+    for (size_t i = 0; i < records; i++)
+        if (ivgen_bytes(iv, sizeof(iv)) != 0) return -1;
+    double t4 = now_sec();
+
+    double n = (double)records;
+    printf("Records: %zu x %zu bytes\n", records, sizeof(field));
+    printf("IV RAND_bytes          : %.1f ns/IV\n", (t3 - t2) * 1e9 / n);
+    printf("IV ivgen (buffered)    : %.1f ns/IV\n", (t4 - t3) * 1e9 / n);
+    printf("XFS-CBC + RAND_bytes IV: %.1f ns/record\n", (t1 - t0) * 1e9 / n);
+    printf("XFS-CBC + ivgen IV     : %.1f ns/record\n", (t2 - t1) * 1e9 / n);
+    return 0;
+}
+
+// Raw block throughput: table-based xfs_encrypt_block per block versus the
+// bitsliced batch primitive; both must produce the same ciphertext.
+static int bench_blocks(const xfs_ctx_t* ctx, const uint8_t* data, size_t bytes) {
+    size_t nblocks = bytes / XFS_BLOCK_SIZE;
+    size_t len = nblocks * XFS_BLOCK_SIZE;
+    uint8_t* a = (uint8_t*)malloc(len ? len : 1);
+    uint8_t* b = (uint8_t*)malloc(len ? len : 1);
+    if (!a || !b) { free(a); free(b); return -1; }
+
+    double t0 = now_sec();
+    for (size_t i = 0; i < nblocks; i++)
+        xfs_encrypt_block(ctx, data + i * XFS_BLOCK_SIZE, a + i * XFS_BLOCK_SIZE);
+    double t1 = now_sec();
+    xfs_encrypt_blocks(ctx, data, b, nblocks);
+    double t2 = now_sec();
+    int rc = memcmp(a, b, len) == 0 ? 0 : -1;
+    xfs_decrypt_blocks(ctx, b, b, nblocks);
+    double t3 = now_sec();
+    if (memcmp(data, b, len) != 0) rc = -1;
+
+    double mb = (double)len / (1024.0 * 1024.0);
+    printf("XFS block (table)      : %.1f MB/s\n", mb / (t1 - t0));
+    printf("XFS blocks (bitsliced) : %.1f MB/s encrypt, %.1f MB/s decrypt%s\n",
+           mb / (t2 - t1), mb / (t3 - t2), rc == 0 ? "" : " (MISMATCH)");
+    free(a); free(b);
+    return rc;
+}
+
+typedef struct {
+    const char* conninfo;
+    pg_writer_t* writer;  // NULL: one pg_insert_secure_person per row
+    const uint8_t* cpf; size_t cpf_len;
+    const uint8_t* email; size_t email_len;
+    size_t rows;
+    int rc;
+} insert_job_t;
+
+static void* insert_worker(void* arg) {
+    insert_job_t* j = (insert_job_t*)arg;
+    for (size_t i = 0; i < j->rows && j->rc == 0; i++) {
+        int64_t id;
+        j->rc = j->writer
+            ? pg_writer_insert(j->writer, j->cpf, j->cpf_len, j->email, j->email_len, &id)
+            : pg_insert_secure_person(j->conninfo, j->cpf, j->cpf_len, j->email, j->email_len, &id);
+    }
+    return NULL;
+}
+
+static double run_inserts(insert_job_t* jobs, unsigned writers) {
+    pthread_t* tids = (pthread_t*)calloc(writers, sizeof(pthread_t));
+    if (!tids) return -1;
+    double t0 = now_sec();
+    unsigned started = 0;
+    for (unsigned t = 0; t < writers; t++, started++)
+        if (pthread_create(&tids[t], NULL, insert_worker, &jobs[t]) != 0) break;
+    for (unsigned t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    double dt = now_sec() - t0;
+    free(tids);
+    for (unsigned t = 0; t < writers; t++) if (t >= started || jobs[t].rc != 0) return -1;
+    return dt;
+}
+
+// Concurrent inserters against PG_CONN: a row-at-a-time insert per call versus
+// the group-commit writer (one multi-row INSERT per flush). Writes real rows.
+static int bench_inserts(const xfs_ctx_t* ctx, const char* conninfo, size_t rows, unsigned writers) {
+    static const char cpf[] = "123.456.789-09";
+    static const char email[] = "bench@example.com";
+    uint8_t *cpf_ct = NULL, *email_ct = NULL;
+    size_t cpf_ct_len = 0, email_ct_len = 0;
+    if (xfs_cbc_encrypt(ctx, (const uint8_t*)cpf, strlen(cpf), NULL, &cpf_ct, &cpf_ct_len) != 0 ||
+        xfs_cbc_encrypt(ctx, (const uint8_t*)email, strlen(email), NULL, &email_ct, &email_ct_len) != 0) {
+        free(cpf_ct); free(email_ct);
+        return -1;
+    }
+
+    int rc = -1;
+    insert_job_t* jobs = (insert_job_t*)calloc(writers, sizeof(insert_job_t));
+    pg_writer_t* w = pg_writer_open(conninfo, 0, 0);
+    if (!jobs || !w) goto cleanup;
+
+    for (unsigned t = 0; t < writers; t++) {
+        jobs[t].conninfo = conninfo;
+        jobs[t].cpf = cpf_ct; jobs[t].cpf_len = cpf_ct_len;
+        jobs[t].email = email_ct; jobs[t].email_len = email_ct_len;
+        jobs[t].rows = rows / writers + (t < rows % writers);
+    }
+    double direct = run_inserts(jobs, writers);
+    for (unsigned t = 0; t < writers; t++) jobs[t].writer = w;
+    double grouped = run_inserts(jobs, writers);
+    if (direct < 0 || grouped < 0) goto cleanup;
+
+    printf("Inserts: %zu rows, %u writers\n", rows, writers);
+    printf("pg_insert_secure_person: %.0f rows/s\n", (double)rows / direct);
+    printf("pg_writer (group commit): %.0f rows/s\n", (double)rows / grouped);
+    rc = 0;
+
+cleanup:
+    pg_writer_close(w);
+    free(jobs);
+    free(cpf_ct); free(email_ct);
+    return rc;
 }
 
 int main(int argc, char** argv) {
     size_t mb = 64;
+    size_t records = 200000;
+    size_t inserts = 0;
+    unsigned writers = 8;
     const char* key = "benchmark-key";
 
     for (int i = 1; i < argc; i++) {
         if (arg_eq(argv[i], "--mb") && i+1 < argc) mb = (size_t)atoi(argv[++i]);
+        else if (arg_eq(argv[i], "--records") && i+1 < argc) records = (size_t)atoi(argv[++i]);
         else if (arg_eq(argv[i], "--key") && i+1 < argc) key = argv[++i];
+        else if (arg_eq(argv[i], "--inserts") && i+1 < argc) inserts = (size_t)atoi(argv[++i]);
+        else if (arg_eq(argv[i], "--writers") && i+1 < argc) writers = (unsigned)atoi(argv[++i]);
     }
 
     size_t bytes = mb * 1024ULL * 1024ULL;
@@ -95,6 +248,14 @@ int main(int argc, char** argv) {
     printf("AES-256-CBC    encrypt: %.3fs (%.1f MB/s)\n", aes_enc, (double)mb / aes_enc);
     printf("AES-256-CBC    decrypt: %.3fs (%.1f MB/s)\n", aes_dec, (double)mb / aes_dec);
 
+    if (bench_blocks(&ctx, data, bytes) != 0) fprintf(stderr, "block bench failed\n");
+    if (records && bench_records(&ctx, records) != 0) fprintf(stderr, "record bench failed\n");
+    if (inserts) {
+        const char* conninfo = getenv("PG_CONN");
+        if (!conninfo || writers == 0) fprintf(stderr, "insert bench needs PG_CONN and --writers > 0\n");
+        else if (bench_inserts(&ctx, conninfo, inserts, writers) != 0) fprintf(stderr, "insert bench failed\n");
+    }
+
     secure_bzero(&ctx, sizeof(ctx));
     secure_bzero(xfs_ct, xfs_ct_len);
     secure_bzero(xfs_pt, xfs_pt_len);
@@ -1,9 +1,13 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "crypto/xorfeistel.h"
 #include "crypto/cbc.h"
+#include "crypto/chunkfile.h"
+#include "crypto/keyring.h"
+#include "db/pg_shards.h"
 #include "db/pg_store.h"
 #include "util/secure_mem.h"
 
@@ -15,63 +19,293 @@ static const char* env_or(const char* key, const char* fallback) {
 static void usage(void) {
     puts("CryptoDB CLI (educational)\n"
          "Commands:\n"
-         "  insert --cpf <str> --email <str> --key <pass>\n"
-         "  get    --id <int>  --key <pass>\n"
+         "  insert --cpf <str> --email <str> --key <pass> [--key-id <n>]\n"
+         "  get    --id <int>  --key <pass> [--key-id <n>]\n"
+         "  get-many --ids <id,id,...> --key <pass> [--key-id <n>]\n"
+         "  rebalance [--batch <rows>]   (sharded only, after adding a shard)\n"
+         "  migrate [--partition none|id|created_at] [--span <ids>] [--ahead <n>]\n"
+         "          [--fillfactor <10..100>] [--id-cache <n>] [--no-brin] [--no-external]\n"
+         "  encrypt-file --in <path> --out <path> --key <pass> [--key-id <n>]\n"
+         "               [--chunk <bytes>] [--threads <n>]\n"
+         "  decrypt-file --in <path> --out <path> --key <pass> [--key-id <n>]\n"
+         "               [--offset <bytes>] [--length <bytes>] [--threads <n>]\n"
          "\nEnv:\n"
-         "  PG_CONN  PostgreSQL conninfo string\n");
+         "  PG_CONN         PostgreSQL conninfo string (database commands)\n"
+         "  PG_CONN_SHARDS  ';'-separated conninfo list; enables the sharded store\n"
+         "  PG_SHARDS_FILE  file with one conninfo per line (alternative to PG_CONN_SHARDS)\n");
 }
 
 static int arg_eq(const char* a, const char* b) { return a && b && strcmp(a,b)==0; }
 
+static int run_db_command(const char* cmd, int argc, char** argv,
+                          const char* conninfo, pg_shards_t* shards);
+
+// Field keys for one invocation. With --key-id, fields are written as keyring
+// tagged ciphertexts; reads accept both tagged and plain XFS-CBC fields.
+typedef struct {
+    xfs_ctx_t ctx;
+    keyring_t* kr;
+    const char* pass;
+    long long key_id; // -1: none given
+} cli_keys_t;
+
+// Keyring loader: the passphrase stands for --key-id only (any id when absent).
+static int cli_load_key(void* user, uint32_t key_id, uint8_t key[XFS_KEY_MAX], size_t* key_len) {
+    const cli_keys_t* k = (const cli_keys_t*)user;
+    size_t n = strlen(k->pass);
+    if (k->key_id >= 0 && (uint32_t)k->key_id != key_id) return -1;
+    if (n == 0 || n > XFS_KEY_MAX) return -1;
+    memcpy(key, k->pass, n);
+    *key_len = n;
+    return 0;
+}
+
+static int cli_keys_init(cli_keys_t* k, const char* pass, long long key_id) {
+    k->pass = pass;
+    k->key_id = key_id;
+    k->kr = NULL;
+    if (key_id > (long long)UINT32_MAX) return -1;
+    if (xfs_init(&k->ctx, (const uint8_t*)pass, strlen(pass), 16) != 0) return -1;
+    k->kr = keyring_create(4, 16, cli_load_key, k);
+    return k->kr ? 0 : -1;
+}
+
+static void cli_keys_wipe(cli_keys_t* k) {
+    secure_bzero(&k->ctx, sizeof(k->ctx));
+    keyring_free(k->kr);
+    k->kr = NULL;
+}
+
+static int encrypt_field(cli_keys_t* k, const char* pt, uint8_t** out, size_t* out_len) {
+    if (k->key_id >= 0)
+        return keyring_encrypt(k->kr, (uint32_t)k->key_id, (const uint8_t*)pt, strlen(pt), out, out_len);
+    return xfs_cbc_encrypt(&k->ctx, (const uint8_t*)pt, strlen(pt), NULL, out, out_len);
+}
+
+static int decrypt_field(cli_keys_t* k, const uint8_t* in, size_t in_len, uint8_t** pt, size_t* pt_len) {
+    if (keyring_is_tagged(in, in_len)) return keyring_decrypt(k->kr, in, in_len, pt, pt_len);
+    return xfs_cbc_decrypt(&k->ctx, in, in_len, pt, pt_len);
+}
+
+static int decrypt_field_to(cli_keys_t* k, const uint8_t* in, size_t in_len,
+                            uint8_t* out, size_t out_cap, size_t* pt_len) {
+    if (keyring_is_tagged(in, in_len)) return keyring_decrypt_to(k->kr, in, in_len, out, out_cap, pt_len);
+    return xfs_cbc_decrypt_to(&k->ctx, in, in_len, out, out_cap, pt_len);
+}
+
+// Many fields at once: plain and tagged fields each go through their batched path;
+// a mix (rows written before --key-id was adopted) is decrypted field by field.
+static int decrypt_fields_to(cli_keys_t* k, xfs_cbc_job_t* jobs, size_t n) {
+    size_t tagged = 0;
+    for (size_t i = 0; i < n; i++) tagged += keyring_is_tagged(jobs[i].in, jobs[i].in_len) != 0;
+    if (tagged == 0) return xfs_cbc_decrypt_many(&k->ctx, jobs, n);
+    if (tagged == n) return keyring_decrypt_many(k->kr, jobs, n);
+
+    int rc = 0;
+    for (size_t i = 0; i < n; i++) {
+        jobs[i].rc = decrypt_field_to(k, jobs[i].in, jobs[i].in_len, jobs[i].out, jobs[i].out_cap, &jobs[i].pt_len);
+        if (jobs[i].rc != 0 && rc == 0) rc = jobs[i].rc;
+    }
+    return rc;
+}
+
+static const char* decrypt_error(int rc) {
+    if (rc == -4) return "unknown key id";
+    if (rc == -5) return "key does not match the key id";
+    return "wrong key?";
+}
+
+// Single-id fetch through either store; allocates cpf/email like pg_get_secure_person.
+static int get_one(const char* conninfo, pg_shards_t* shards, int64_t id,
+                   uint8_t** cpf, size_t* cpf_len, uint8_t** email, size_t* email_len) {
+    if (!shards) return pg_get_secure_person(conninfo, id, cpf, cpf_len, email, email_len);
+
+    pg_sharded_people_t people;
+    if (pg_shards_get(shards, &id, 1, &people) != 0) return -1;
+    if (people.count == 0) { pg_sharded_people_free(&people); return -4; }
+
+    const pg_person_view_t* row = &people.rows[0];
+    *cpf = (uint8_t*)malloc(row->cpf_len);
+    *email = (uint8_t*)malloc(row->email_len);
+    if (!*cpf || !*email) {
+        free(*cpf); free(*email);
+        pg_sharded_people_free(&people);
+        return -5;
+    }
+    memcpy(*cpf, row->cpf_cipher, row->cpf_len);
+    memcpy(*email, row->email_cipher, row->email_len);
+    *cpf_len = row->cpf_len;
+    *email_len = row->email_len;
+    pg_sharded_people_free(&people);
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) { usage(); return 1; }
     const char* cmd = argv[1];
 
+    if (arg_eq(cmd, "encrypt-file") || arg_eq(cmd, "decrypt-file")) {
+        const char* in = NULL;
+        const char* out = NULL;
+        const char* key = NULL;
+        long long key_id = -1;
+        unsigned long long chunk = 0, offset = 0, length = 0;
+        unsigned threads = 0;
+
+        for (int i = 2; i < argc; i++) {
+            if (arg_eq(argv[i], "--in") && i+1 < argc) in = argv[++i];
+            else if (arg_eq(argv[i], "--out") && i+1 < argc) out = argv[++i];
+            else if (arg_eq(argv[i], "--key") && i+1 < argc) key = argv[++i];
+            else if (arg_eq(argv[i], "--key-id") && i+1 < argc) key_id = strtoll(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--chunk") && i+1 < argc) chunk = strtoull(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--offset") && i+1 < argc) offset = strtoull(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--length") && i+1 < argc) length = strtoull(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--threads") && i+1 < argc) threads = (unsigned)atoi(argv[++i]);
+        }
+        if (!in || !out || !key || key_id > UINT32_MAX || chunk > XFS_FILE_MAX_CHUNK) { usage(); return 3; }
+
+        xfs_ctx_t ctx;
+        if (xfs_init(&ctx, (const uint8_t*)key, strlen(key), 16) != 0) {
+            fprintf(stderr, "ERROR: xfs_init failed\n");
+            return 4;
+        }
+
+        int rc;
+        if (arg_eq(cmd, "encrypt-file")) {
+            rc = xfs_file_encrypt(&ctx, key_id < 0 ? 0 : (uint32_t)key_id, in, out, (uint32_t)chunk, threads);
+            if (rc != 0) fprintf(stderr, "ERROR: file encryption failed (%d)\n", rc);
+        } else {
+            xfs_file_info_t info;
+            rc = xfs_file_info(in, &info);
+            if (rc != 0) fprintf(stderr, "ERROR: not a chunked XFS file\n");
+            else if (key_id >= 0 && info.key_id != (uint32_t)key_id) {
+                fprintf(stderr, "ERROR: file was written with key id %u\n", info.key_id);
+                rc = -1;
+            } else {
+                rc = xfs_file_decrypt(&ctx, in, out, offset, length, threads);
+                if (rc == -4) fprintf(stderr, "ERROR: file decryption failed (wrong key?)\n");
+                else if (rc != 0) fprintf(stderr, "ERROR: file decryption failed (%d)\n", rc);
+            }
+        }
+
+        secure_bzero(&ctx, sizeof(ctx));
+        return rc == 0 ? 0 : 5;
+    }
+
+    pg_shards_t* shards = NULL;
+    const char* shard_list = env_or("PG_CONN_SHARDS", NULL);
+    const char* shard_file = env_or("PG_SHARDS_FILE", NULL);
+    if (shard_list || shard_file) {
+        shards = shard_list ? pg_shards_from_list(shard_list) : pg_shards_from_file(shard_file);
+        if (!shards) {
+            fprintf(stderr, "ERROR: invalid shard list\n");
+            return 2;
+        }
+    }
+
     const char* conninfo = env_or("PG_CONN", NULL);
-    if (!conninfo) {
+    if (!conninfo && !shards) {
         fprintf(stderr, "ERROR: set PG_CONN env var (PostgreSQL conninfo).\n");
         return 2;
     }
 
+    int rc = run_db_command(cmd, argc, argv, conninfo, shards);
+    pg_shards_free(shards);
+    return rc;
+}
+
+// Database commands. With shards != NULL every access goes through the sharded store.
+static int run_db_command(const char* cmd, int argc, char** argv,
+                          const char* conninfo, pg_shards_t* shards) {
+    if (arg_eq(cmd, "migrate")) {
+        pg_schema_opts_t opts;
+        pg_schema_opts_default(&opts);
+
+        for (int i = 2; i < argc; i++) {
+            if (arg_eq(argv[i], "--partition") && i+1 < argc) {
+                const char* m = argv[++i];
+                if (arg_eq(m, "none")) opts.partition = PG_PARTITION_NONE;
+                else if (arg_eq(m, "id")) opts.partition = PG_PARTITION_BY_ID;
+                else if (arg_eq(m, "created_at")) opts.partition = PG_PARTITION_BY_CREATED_AT;
+                else { usage(); return 3; }
+            }
+            else if (arg_eq(argv[i], "--span") && i+1 < argc) opts.id_partition_span = strtoll(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--ahead") && i+1 < argc) opts.partitions_ahead = atoi(argv[++i]);
+            else if (arg_eq(argv[i], "--fillfactor") && i+1 < argc) opts.fillfactor = atoi(argv[++i]);
+            else if (arg_eq(argv[i], "--id-cache") && i+1 < argc) opts.id_cache = atoi(argv[++i]);
+            else if (arg_eq(argv[i], "--no-brin")) opts.brin_created_at = 0;
+            else if (arg_eq(argv[i], "--no-external")) opts.storage_external = 0;
+        }
+
+        int mrc = shards ? pg_shards_ensure_schema(shards, &opts) : pg_ensure_schema(conninfo, &opts);
+        if (shards && mrc == -3) {
+            fprintf(stderr, "ERROR: a shard has a non-BIGINT id column (pre-migration SERIAL table)\n");
+            return 4;
+        }
+        if (shards && mrc == -4) {
+            fprintf(stderr, "ERROR: shards must be unpartitioned (use --partition none)\n");
+            return 4;
+        }
+        if (mrc == -5) {
+            fprintf(stderr, "ERROR: --partition/--span differ from the layout stored in the database\n");
+            return 4;
+        }
+        if (mrc != 0) {
+            fprintf(stderr, "ERROR: schema migration failed\n");
+            return 4;
+        }
+        puts("Schema up to date");
+        return 0;
+    }
+
     if (arg_eq(cmd, "insert")) {
         const char* cpf = NULL;
         const char* email = NULL;
         const char* key = NULL;
+        long long key_id = -1;
 
         for (int i = 2; i < argc; i++) {
             if (arg_eq(argv[i], "--cpf") && i+1 < argc) cpf = argv[++i];
             else if (arg_eq(argv[i], "--email") && i+1 < argc) email = argv[++i];
             else if (arg_eq(argv[i], "--key") && i+1 < argc) key = argv[++i];
+            else if (arg_eq(argv[i], "--key-id") && i+1 < argc) key_id = strtoll(argv[++i], NULL, 10);
         }
         if (!cpf || !email || !key) { usage(); return 3; }
 
-        xfs_ctx_t ctx;
-        if (xfs_init(&ctx, (const uint8_t*)key, strlen(key), 16) != 0) {
+        cli_keys_t keys;
+        if (cli_keys_init(&keys, key, key_id) != 0) {
             fprintf(stderr, "ERROR: xfs_init failed\n");
+            cli_keys_wipe(&keys);
             return 4;
         }
 
         uint8_t* cpf_ct = NULL; size_t cpf_ct_len = 0;
         uint8_t* email_ct = NULL; size_t email_ct_len = 0;
 
-        if (xfs_cbc_encrypt(&ctx, (const uint8_t*)cpf, strlen(cpf), NULL, &cpf_ct, &cpf_ct_len) != 0 ||
-            xfs_cbc_encrypt(&ctx, (const uint8_t*)email, strlen(email), NULL, &email_ct, &email_ct_len) != 0) {
+        if (encrypt_field(&keys, cpf, &cpf_ct, &cpf_ct_len) != 0 ||
+            encrypt_field(&keys, email, &email_ct, &email_ct_len) != 0) {
             fprintf(stderr, "ERROR: encryption failed\n");
+            cli_keys_wipe(&keys);
             free(cpf_ct); free(email_ct);
             return 5;
         }
 
-        int id = 0;
-        if (pg_insert_secure_person(conninfo, cpf_ct, cpf_ct_len, email_ct, email_ct_len, &id) != 0) {
-            fprintf(stderr, "ERROR: DB insert failed\n");
+        int64_t id = 0;
+        int irc = shards
+            ? pg_shards_insert(shards, cpf_ct, cpf_ct_len, email_ct, email_ct_len, &id)
+            : pg_insert_secure_person(conninfo, cpf_ct, cpf_ct_len, email_ct, email_ct_len, &id);
+        if (irc != 0) {
+            if (irc == -6) fprintf(stderr, "ERROR: no schema yet, run migrate first\n");
+            else fprintf(stderr, "ERROR: DB insert failed\n");
+            cli_keys_wipe(&keys);
             free(cpf_ct); free(email_ct);
             return 6;
         }
 
-        printf("Inserted id=%d\n", id);
+        printf("Inserted id=%" PRId64 "\n", id);
 
         // Clear sensitive buffers
-        secure_bzero(&ctx, sizeof(ctx));
+        cli_keys_wipe(&keys);
         secure_bzero(cpf_ct, cpf_ct_len);
         secure_bzero(email_ct, email_ct_len);
         free(cpf_ct); free(email_ct);
@@ -80,25 +314,28 @@ int main(int argc, char** argv) {
 
     if (arg_eq(cmd, "get")) {
         const char* key = NULL;
-        int id = -1;
+        long long key_id = -1;
+        int64_t id = -1;
 
         for (int i = 2; i < argc; i++) {
             if (arg_eq(argv[i], "--key") && i+1 < argc) key = argv[++i];
-            else if (arg_eq(argv[i], "--id") && i+1 < argc) id = atoi(argv[++i]);
+            else if (arg_eq(argv[i], "--id") && i+1 < argc) id = strtoll(argv[++i], NULL, 10);
+            else if (arg_eq(argv[i], "--key-id") && i+1 < argc) key_id = strtoll(argv[++i], NULL, 10);
         }
         if (!key || id <= 0) { usage(); return 3; }
 
         uint8_t* cpf_ct = NULL; size_t cpf_ct_len = 0;
         uint8_t* email_ct = NULL; size_t email_ct_len = 0;
 
-        if (pg_get_secure_person(conninfo, id, &cpf_ct, &cpf_ct_len, &email_ct, &email_ct_len) != 0) {
-            fprintf(stderr, "ERROR: DB get failed (id=%d)\n", id);
+        if (get_one(conninfo, shards, id, &cpf_ct, &cpf_ct_len, &email_ct, &email_ct_len) != 0) {
+            fprintf(stderr, "ERROR: DB get failed (id=%" PRId64 ")\n", id);
             return 4;
         }
 
-        xfs_ctx_t ctx;
-        if (xfs_init(&ctx, (const uint8_t*)key, strlen(key), 16) != 0) {
+        cli_keys_t keys;
+        if (cli_keys_init(&keys, key, key_id) != 0) {
             fprintf(stderr, "ERROR: xfs_init failed\n");
+            cli_keys_wipe(&keys);
             free(cpf_ct); free(email_ct);
             return 5;
         }
@@ -106,17 +343,19 @@ int main(int argc, char** argv) {
         uint8_t* cpf_pt = NULL; size_t cpf_pt_len = 0;
         uint8_t* email_pt = NULL; size_t email_pt_len = 0;
 
-        if (xfs_cbc_decrypt(&ctx, cpf_ct, cpf_ct_len, &cpf_pt, &cpf_pt_len) != 0 ||
-            xfs_cbc_decrypt(&ctx, email_ct, email_ct_len, &email_pt, &email_pt_len) != 0) {
-            fprintf(stderr, "ERROR: decryption failed (wrong key?)\n");
+        int drc = decrypt_field(&keys, cpf_ct, cpf_ct_len, &cpf_pt, &cpf_pt_len);
+        if (drc == 0) drc = decrypt_field(&keys, email_ct, email_ct_len, &email_pt, &email_pt_len);
+        if (drc != 0) {
+            fprintf(stderr, "ERROR: decryption failed (%s)\n", decrypt_error(drc));
+            cli_keys_wipe(&keys);
             free(cpf_ct); free(email_ct);
             free(cpf_pt); free(email_pt);
             return 6;
         }
 
-        printf("id=%d\ncpf=%s\nemail=%s\n", id, (char*)cpf_pt, (char*)email_pt);
+        printf("id=%" PRId64 "\ncpf=%s\nemail=%s\n", id, (char*)cpf_pt, (char*)email_pt);
 
-        secure_bzero(&ctx, sizeof(ctx));
+        cli_keys_wipe(&keys);
         secure_bzero(cpf_ct, cpf_ct_len);
         secure_bzero(email_ct, email_ct_len);
         secure_bzero(cpf_pt, cpf_pt_len);
@@ -127,6 +366,130 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (arg_eq(cmd, "get-many")) {
+        const char* key = NULL;
+        const char* list = NULL;
+        long long key_id = -1;
+
+        for (int i = 2; i < argc; i++) {
+            if (arg_eq(argv[i], "--key") && i+1 < argc) key = argv[++i];
+            else if (arg_eq(argv[i], "--ids") && i+1 < argc) list = argv[++i];
+            else if (arg_eq(argv[i], "--key-id") && i+1 < argc) key_id = strtoll(argv[++i], NULL, 10);
+        }
+        if (!key || !list) { usage(); return 3; }
+
+        size_t n = 1;
+        for (const char* p = list; *p; p++) n += (*p == ',');
+        int64_t* ids = (int64_t*)malloc(n * sizeof(int64_t));
+        if (!ids) { fprintf(stderr, "ERROR: out of memory\n"); return 4; }
+        size_t k = 0;
+        for (const char* p = list; *p; ) {
+            char* end = NULL;
+            long long v = strtoll(p, &end, 10);
+            if (end == p || v <= 0) { free(ids); usage(); return 3; }
+            ids[k++] = v;
+            p = (*end == ',') ? end + 1 : end;
+            if (*end && *end != ',') { free(ids); usage(); return 3; }
+        }
+
+        pg_people_t people;
+        pg_sharded_people_t sharded;
+        const pg_person_view_t* rows = NULL;
+        size_t count = 0;
+        int grc;
+        if (shards) {
+            grc = pg_shards_get(shards, ids, k, &sharded);
+            rows = sharded.rows; count = sharded.count;
+        } else {
+            grc = pg_get_secure_people(conninfo, ids, k, &people);
+            rows = people.rows; count = people.count;
+        }
+        free(ids);
+        if (grc != 0) {
+            fprintf(stderr, "ERROR: DB get failed\n");
+            return 4;
+        }
+
+        cli_keys_t keys;
+        if (cli_keys_init(&keys, key, key_id) != 0) {
+            fprintf(stderr, "ERROR: xfs_init failed\n");
+            cli_keys_wipe(&keys);
+            if (shards) pg_sharded_people_free(&sharded); else pg_people_free(&people);
+            return 5;
+        }
+
+        // One arena for every plaintext: a field never needs more than its
+        // ciphertext length, plus a terminator for printing. All fields are
+        // decrypted in one batched call.
+        size_t arena_len = 0;
+        for (size_t i = 0; i < count; i++)
+            arena_len += rows[i].cpf_len + rows[i].email_len + 2;
+        uint8_t* arena = (uint8_t*)malloc(arena_len ? arena_len : 1);
+        xfs_cbc_job_t* jobs = (xfs_cbc_job_t*)malloc((count ? 2 * count : 1) * sizeof(xfs_cbc_job_t));
+        if (!arena || !jobs) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            free(arena); free(jobs);
+            cli_keys_wipe(&keys);
+            if (shards) pg_sharded_people_free(&sharded); else pg_people_free(&people);
+            return 5;
+        }
+
+        uint8_t* cur = arena;
+        for (size_t i = 0; i < count; i++) {
+            xfs_cbc_job_t* f = &jobs[2 * i];
+            f[0].in = rows[i].cpf_cipher;   f[0].in_len = rows[i].cpf_len;
+            f[0].out = cur;                 f[0].out_cap = rows[i].cpf_len;
+            cur += rows[i].cpf_len + 1;
+            f[1].in = rows[i].email_cipher; f[1].in_len = rows[i].email_len;
+            f[1].out = cur;                 f[1].out_cap = rows[i].email_len;
+            cur += rows[i].email_len + 1;
+        }
+
+        int rc = 0;
+        int drc = decrypt_fields_to(&keys, jobs, 2 * count);
+        if (drc != 0) {
+            rc = 6;
+            fprintf(stderr, "ERROR: decryption failed (%s)\n", decrypt_error(drc));
+        }
+        for (size_t i = 0; rc == 0 && i < count; i++) {
+            xfs_cbc_job_t* f = &jobs[2 * i];
+            f[0].out[f[0].pt_len] = 0;
+            f[1].out[f[1].pt_len] = 0;
+            printf("id=%" PRId64 "\ncpf=%s\nemail=%s\n", rows[i].id, (char*)f[0].out, (char*)f[1].out);
+        }
+
+        cli_keys_wipe(&keys);
+        secure_bzero(arena, arena_len);
+        free(arena);
+        free(jobs);
+        if (shards) pg_sharded_people_free(&sharded); else pg_people_free(&people);
+        return rc;
+    }
+
+    if (arg_eq(cmd, "rebalance")) {
+        size_t batch = 1000;
+        for (int i = 2; i < argc; i++) {
+            if (arg_eq(argv[i], "--batch") && i+1 < argc) batch = (size_t)strtoull(argv[++i], NULL, 10);
+        }
+        if (!shards) {
+            fprintf(stderr, "ERROR: rebalance needs PG_CONN_SHARDS or PG_SHARDS_FILE\n");
+            return 3;
+        }
+
+        size_t moved = 0;
+        int brc = pg_shards_rebalance(shards, batch, &moved);
+        if (brc == -3) {
+            fprintf(stderr, "ERROR: moved %zu rows; some ids exist with different data on two shards and were left in place\n", moved);
+            return 4;
+        }
+        if (brc != 0) {
+            fprintf(stderr, "ERROR: rebalance failed after moving %zu rows\n", moved);
+            return 4;
+        }
+        printf("Rebalanced: moved %zu rows across %zu shards\n", moved, pg_shards_count(shards));
+        return 0;
+    }
+
     usage();
     return 1;
 }